@@ -6,10 +6,6 @@
 #include <math.h>
 #include "utils.h"
 
-#define IC_RANDOM 0.0385
-#define IC_ENGLISH 0.0650
-#define IC_SPANISH 0.0770
-
 int main(int argc, char *argv[]) {
     int opt;
     int n = -1; /* Key size */
@@ -17,11 +13,16 @@ int main(int argc, char *argv[]) {
     char *output_filename = NULL;
     FILE *output_file = NULL;  
     int language = 0; /* 0 for English, 1 for Spanish (DEFAULT: ENGLISH)*/
+    int nthreads = default_threads();
+    char *model_filename = NULL; /* Overrides -l */
+    LANG_MODEL loaded;
+    const LANG_MODEL *model;
+    int print_profile = 0;
 
     int i;
 
     /* Parse command line arguments */
-    while ((opt = getopt(argc, argv, "n:i:o:l:")) != -1) {
+    while ((opt = getopt(argc, argv, "n:i:o:l:L:t:p")) != -1) {
         switch (opt) {
             case 'n':
                 n = atoi(optarg);
@@ -35,98 +36,57 @@ int main(int argc, char *argv[]) {
             case 'l':
                 language = atoi(optarg);
                 break;
+            case 'L':
+                model_filename = optarg;
+                break;
+            case 't':
+                nthreads = atoi(optarg);
+                break;
+            case 'p':
+                print_profile = 1;
+                break;
             default:
-                fprintf(stderr, "Usage: %s [-n n] [-l language (0 for english / 1 for spanish)] [-i infile] [-o outfile]\n", argv[0]);
+                fprintf(stderr, "Usage: %s [-n n] [-l language (0 for english / 1 for spanish)] [-L modelfile] [-t threads] [-p] [-i infile] [-o outfile]\n", argv[0]);
                 return EXIT_FAILURE;
         }
     }
 
-    /*Open the input file for reading*/
-    char *temp = NULL;
-    size_t bytes_read = 0;
-
-    if (input_filename == NULL) {
-        /* Leer desde stdin */
-        size_t capacity = 1024;
-        temp = malloc(capacity);
-        if (!temp) {
-            perror("malloc");
-            return EXIT_FAILURE;
-        }
-    
-        int c;
-        while ((c = fgetc(stdin)) != EOF) {
-            if (bytes_read + 1 >= capacity) {
-                capacity *= 2;
-                temp = realloc(temp, capacity);
-                if (!temp) {
-                    perror("realloc");
-                    return EXIT_FAILURE;
-                }
-            }
-            temp[bytes_read++] = (char)c;
-        }
-        temp[bytes_read] = '\0';
-    } else {
-        /* Leer desde archivo */
-        FILE *input_file = fopen(input_filename, "rb");
-        if (input_file == NULL) {
-            perror("Error opening input file");
-            return EXIT_FAILURE;
-        }
-
-        fseek(input_file, 0, SEEK_END);
-        bytes_read = ftell(input_file);
-        rewind(input_file);
-
-        temp = malloc(bytes_read + 1);
-        if (!temp) {
-            perror("malloc");
-            fclose(input_file);
-            return EXIT_FAILURE;
-        }
-
-        if (fread(temp, 1, bytes_read, input_file) != bytes_read) {
-            perror("Error reading file");
-            fclose(input_file);
-            free(temp);
+    /*Language model: builtin unless a model file is given*/
+    model = lang_model_builtin(language);
+    if (model_filename != NULL) {
+        if (lang_model_load(&loaded, model_filename) != 0) {
+            perror("Error loading model file");
             return EXIT_FAILURE;
         }
-        temp[bytes_read] = '\0';
-        
-        fclose(input_file);
+        model = &loaded;
     }
 
-    /* Normalize input to A-Z */
-    char *buffer = malloc(bytes_read);
-
-    int purged = normalize_AZ(temp, bytes_read, buffer);
-    bytes_read = bytes_read - purged;
+    /*Read and normalize the input to A-Z*/
+    size_t bytes_read = 0;
+    char *buffer = read_text_AZ(input_filename, &bytes_read);
+    if (buffer == NULL) {
+        perror("Error reading input");
+        return EXIT_FAILURE;
+    }
 
     if (n <= 0){
-        n = bytes_read; /*Default try all n possible*/
+        n = ic_default_bound(bytes_read); /*Default try n up to IC_MAX_PERIOD*/
     }
 
     double best_ic = 0.0;
     int best_ic_idx = 0;
 
-    for (i = 1; i < n; i++){
-        double ic = calculate_ic(buffer, bytes_read, i);
-        
-        if (language == 1) { 
-            if (fabs(ic - IC_SPANISH) < fabs(best_ic - IC_SPANISH)){
-                best_ic = ic;
-                best_ic_idx = i;
-            }
-        } else {
-            if (fabs(ic - IC_ENGLISH) < fabs(best_ic - IC_ENGLISH)){
-                best_ic = ic;
-                best_ic_idx = i;
-            }
-        }
-        
+    /*IC of every candidate key length in one scan*/
+    double *profile = malloc(n * sizeof(double));
+    if (!profile || ic_profile(buffer, bytes_read, n, profile, nthreads) != 0) {
+        perror("malloc");
+        free(profile);
+        free(buffer);
+        return EXIT_FAILURE;
     }
 
+    best_ic_idx = ic_best_period(profile, n, model->ic, &best_ic);
+
     /*Open the output file for writing*/
     if (output_filename == NULL){
         output_file = stdout;
@@ -142,12 +102,23 @@ int main(int argc, char *argv[]) {
 
     fprintf(output_file, "====== INDEX OF COINCIDENCE TEST =====\n");
     fprintf(output_file, "Best IC found for n = %d: %f\n", best_ic_idx, best_ic);
-    fprintf(output_file, "Diffetence to English IC: %f\n", fabs(best_ic - IC_ENGLISH));
+    fprintf(output_file, "Difference to %s IC: %f\n", model->name, fabs(best_ic - model->ic));
     fprintf(output_file, "\n");
     fprintf(output_file, "Expected IC for random text: %f\n", IC_RANDOM);
-    fprintf(output_file, "Expected IC for English text: %f\n", IC_ENGLISH);
+    fprintf(output_file, "Expected IC for %s text: %f\n", model->name, model->ic);
+    if (print_profile) {
+        fprintf(output_file, "\n");
+        fprintf(output_file, "IC by key length:\n");
+        for (i = 1; i < n; i++) {
+            fprintf(output_file, "n = %d: %f\n", i, profile[i]);
+        }
+    }
     fclose(output_file);
+    free(profile);
     free(buffer);
+    if (model_filename != NULL) {
+        lang_model_close(&loaded);
+    }
 
     return EXIT_SUCCESS;
 }
@@ -3,8 +3,78 @@
 #include <string.h>
 #include <unistd.h>
 #include <bits/getopt_core.h>
+#include <time.h>
 #include "utils.h"
 
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Per-character GMP encryption, kept as the reference for the benchmark */
+static void affine_cipher_mpz(const char *input, char *output, size_t length, mpz_t a, mpz_t b, mpz_t mod) {
+    mpz_t x, y;
+    mpz_inits(x, y, NULL);
+
+    for (size_t i = 0; i < length; i++) {
+        char c = input[i];
+        if (c >= 'A' && c <= 'Z') {
+            mpz_set_ui(x, c - 'A');
+            mpz_mul(y, a, x);
+            mpz_add(y, y, b);
+            mpz_mod(y, y, mod);
+            output[i] = (char)(mpz_get_ui(y) + 'A');
+        } else {
+            output[i] = c;
+        }
+    }
+    output[length] = '\0';
+    mpz_clears(x, y, NULL);
+}
+
+/* Compares the GMP reference with affine_cipher on length random letters */
+static int benchmark(size_t length, mpz_t a, mpz_t b, mpz_t mod) {
+    char *text = malloc(length + 1);
+    char *ref = malloc(length + 1);
+    char *fast = malloc(length + 1);
+    double t0, t1, t2;
+    int ok;
+
+    if (!text || !ref || !fast) {
+        perror("malloc");
+        free(text);
+        free(ref);
+        free(fast);
+        return EXIT_FAILURE;
+    }
+    srand(1);
+    for (size_t i = 0; i < length; i++) {
+        text[i] = 'A' + rand() % 26;
+    }
+    text[length] = '\0';
+
+    t0 = now_seconds();
+    affine_cipher_mpz(text, ref, length, a, b, mod);
+    t1 = now_seconds();
+    affine_cipher(text, fast, length, a, b, mod);
+    t2 = now_seconds();
+    ok = (memcmp(ref, fast, length) == 0);
+
+    printf("====== AFFINE BENCHMARK =====\n");
+    printf("Characters: %zu\n", length);
+    printf("Kernel           : %s\n", substitute_AZ_kernel());
+    printf("GMP per character: %.3e chars/s\n", length / (t1 - t0));
+    printf("affine_cipher    : %.3e chars/s\n", length / (t2 - t1));
+    printf("Speedup          : %.1fx\n", (t1 - t0) / (t2 - t1));
+    printf("Outputs match    : %s\n", ok ? "yes" : "NO");
+
+    free(text);
+    free(ref);
+    free(fast);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
 int main(int argc, char *argv[]) {
     int opt;
     int cipher = -1; /* 1 for cipher, 0 for decipher, -1 for unset (error) */
@@ -13,12 +83,13 @@ int main(int argc, char *argv[]) {
     int mod_raw = -1; /* -1 for unset (error) */
     int a_raw = -1, b_raw = -1; /* coefficients for affine cipher, -1 for unset (error) */
     FILE *output_file;
+    size_t bench_length = 0;
 
     mpz_t a, b, mod;
     mpz_inits(a, b, mod, NULL);
 
     /* Parse command line arguments */
-    while ((opt = getopt(argc, argv, "CDm:a:b:i:o:")) != -1) {
+    while ((opt = getopt(argc, argv, "CDm:a:b:i:o:B:")) != -1) {
         switch (opt) {
             case 'C':
                 cipher = 1;
@@ -41,11 +112,19 @@ int main(int argc, char *argv[]) {
             case 'o':
                 output_filename = optarg;
                 break;
+            case 'B':
+                bench_length = strtoull(optarg, NULL, 10);
+                break;
             default:
                 fprintf(stderr, "Usage: %s -C|-D -m mod -a a -b b -i inputfile -o outputfile\n", argv[0]);
+                fprintf(stderr, "       %s -B length -m mod -a a -b b (benchmark)\n", argv[0]);
                 return EXIT_FAILURE;
         }
     }
+    /* The benchmark does not need -C/-D */
+    if (bench_length > 0) {
+        cipher = 1;
+    }
     /* Verify the correct arguments were passed in the execution */
     if (cipher == -1 || mod_raw == -1 || a_raw == -1 || b_raw == -1) {
         fprintf(stderr, "Error: Missing or invalid arguments.\n");
@@ -66,6 +145,10 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
 
+    if (bench_length > 0) {
+        return benchmark(bench_length, a, b, mod);
+    }
+
     /*Open the input file for reading*/
     char *buffer = NULL;
     size_t bytes_read = 0;
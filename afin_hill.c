@@ -1,10 +1,170 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <unistd.h>
 #include <bits/getopt_core.h>
 #include "utils.h"
 
+/* Recovers A and b from aligned plaintext and ciphertext files */
+static int known_plaintext_attack(const char *plain_filename, const char *cipher_filename,
+                                  const char *output_filename, int n, int mod_raw, int nthreads) {
+    size_t plain_l = 0, cipher_l = 0;
+    char *plain = read_text_AZ(plain_filename, &plain_l);
+    char *cipher = read_text_AZ(cipher_filename, &cipher_l);
+    uint32_t *key = malloc(((size_t)n * n + n) * sizeof(uint32_t));
+    uint64_t trial = 0;
+    FILE *output_file;
+    int i;
+
+    if (!plain || !cipher || !key) {
+        perror("Error reading input");
+        free(plain);
+        free(cipher);
+        free(key);
+        return EXIT_FAILURE;
+    }
+
+    /*Only the whole blocks present in both texts are used*/
+    size_t length = (plain_l < cipher_l) ? plain_l : cipher_l;
+    int status = hill_known_plaintext(plain, cipher, length, n, (uint32_t)mod_raw, nthreads, key, &trial);
+    if (status != 0) {
+        fprintf(stderr, "Error: No key maps the plaintext to the ciphertext.\n");
+        free(plain);
+        free(cipher);
+        free(key);
+        return EXIT_FAILURE;
+    }
+
+    if (output_filename == NULL){
+        output_file = stdout;
+    }else{
+        output_file = fopen(output_filename, "w");
+        if (output_file == NULL) {
+            perror("Error opening output file");
+            free(plain);
+            free(cipher);
+            free(key);
+            return EXIT_FAILURE;
+        }
+    }
+
+    fprintf(output_file, "====== KNOWN PLAINTEXT ATTACK =====\n");
+    fprintf(output_file, "Blocks: %zu\n", length / n);
+    fprintf(output_file, "Key found with block subset %llu, verified on every block\n", (unsigned long long)trial);
+    fprintf(output_file, "-a ");
+    for (i = 0; i < n * n; i++) {
+        fprintf(output_file, "%u%s", key[i], (i < n * n - 1) ? "," : "");
+    }
+    fprintf(output_file, " -b ");
+    for (i = 0; i < n; i++) {
+        fprintf(output_file, "%u%s", key[n * n + i], (i < n - 1) ? "," : "");
+    }
+    fprintf(output_file, "\n");
+
+    fclose(output_file);
+    free(plain);
+    free(cipher);
+    free(key);
+    return EXIT_SUCCESS;
+}
+
+/* Ranks keys by the fitness of the ciphertext deciphered with them */
+static int ciphertext_only_attack(const char *cipher_filename, const char *output_filename, int n,
+                                  const LANG_MODEL *model, int nthreads, int restarts, int ncand, int print_plaintext) {
+    size_t length = 0;
+    char *text = read_text_AZ(cipher_filename, &length);
+    size_t k = (size_t)n * n + n;
+    uint32_t *keys = malloc(ncand * k * sizeof(uint32_t));
+    uint32_t *d = malloc(k * sizeof(uint32_t));
+    double *scores = malloc(ncand * sizeof(double));
+    FILE *output_file;
+    int found, i, j;
+
+    if (!text || !keys || !d || !scores) {
+        perror("Error reading input");
+        free(text);
+        free(keys);
+        free(d);
+        free(scores);
+        return EXIT_FAILURE;
+    }
+
+    found = hill_break(text, length, n, model, nthreads, restarts, keys, scores, ncand);
+    if (found <= 0) {
+        fprintf(stderr, "Error: text too short.\n");
+        free(text);
+        free(keys);
+        free(d);
+        free(scores);
+        return EXIT_FAILURE;
+    }
+
+    if (output_filename == NULL){
+        output_file = stdout;
+    }else{
+        output_file = fopen(output_filename, "w");
+        if (output_file == NULL) {
+            perror("Error opening output file");
+            free(text);
+            free(keys);
+            free(d);
+            free(scores);
+            return EXIT_FAILURE;
+        }
+    }
+
+    size_t sample = (length / n * n < HILL_BREAK_SAMPLE) ? length / n * n : (size_t)(HILL_BREAK_SAMPLE / n * n);
+    fprintf(output_file, "====== CIPHERTEXT-ONLY ATTACK =====\n");
+    fprintf(output_file, "Letters: %zu (%zu scored)\n", length, sample);
+    if (n == 2) {
+        fprintf(output_file, "Search: every key row, best %d paired\n", HILL_BREAK_ROWS);
+    } else if (n <= HILL_BREAK_EXHAUSTIVE) {
+        fprintf(output_file, "Search: every key row, best %d combined by hill climbing (%d restarts)\n", HILL_BREAK_ROWS, restarts);
+    } else {
+        fprintf(output_file, "Search: every key row mod 13, best lifted to mod 26, best %d combined by hill climbing (%d restarts)\n", HILL_BREAK_ROWS, restarts);
+    }
+    fprintf(output_file, "Scoring: %s quadgram log-likelihood, higher is better\n", model->name);
+    fprintf(output_file, "\n");
+    for (i = 0; i < found; i++) {
+        const uint32_t *key = keys + i * k;
+        fprintf(output_file, "%2d. -a ", i + 1);
+        for (j = 0; j < n * n; j++) {
+            fprintf(output_file, "%u%s", key[j], (j < n * n - 1) ? "," : "");
+        }
+        fprintf(output_file, " -b ");
+        for (j = 0; j < n; j++) {
+            fprintf(output_file, "%u%s", key[n * n + j], (j < n - 1) ? "," : "");
+        }
+        fprintf(output_file, ": %.2f (%.4f per letter)\n", scores[i], scores[i] / sample);
+    }
+
+    /*Decipher with the best key: x = A^-1 (y - b)*/
+    if (print_plaintext && hill_inverse_mod(keys, d, n, 26) == 0) {
+        char *plain = malloc(length / n * n + 1);
+        for (i = 0; i < n; i++) {
+            uint32_t acc = 0;
+            for (j = 0; j < n; j++) {
+                acc = (acc + d[i * n + j] * keys[n * n + j]) % 26;
+            }
+            d[n * n + i] = (26 - acc) % 26;
+        }
+        if (plain != NULL && hill_affine_AZ(text, plain, length / n * n, d, d + n * n, n, 26) == 0) {
+            fprintf(output_file, "\nPlaintext:\n%s\n", plain);
+        } else {
+            perror("Error deciphering");
+        }
+        free(plain);
+    }
+
+    fclose(output_file);
+    free(text);
+    free(keys);
+    free(d);
+    free(scores);
+    return EXIT_SUCCESS;
+}
+
 int main(int argc, char *argv[]) {
     int opt;
     int cipher = -1; /* 1 for cipher, 0 for decipher, -1 for unset (error) */
@@ -14,7 +174,13 @@ int main(int argc, char *argv[]) {
     char *a_str = NULL, *b_str = NULL; /* coefficients for affine cipher, NULL for unset (error) */
     FILE *output_file;
     int n = -1; /* dimension of the matrix, -1 for unset (error) */
-    int padding = 0;
+    int attack = 0; /* 1 for the known-plaintext attack, 2 for ciphertext-only */
+    char *plain_filename = NULL; /* known plaintext of the attack */
+    int nthreads = default_threads();
+    char *model_filename = NULL; /* quadgram model of the ciphertext-only attack */
+    int restarts = 100; /* hill-climbing restarts of the ciphertext-only attack */
+    int ncand = 5; /* keys listed by the ciphertext-only attack */
+    int print_plaintext = 0;
 
     int i, j;
 
@@ -22,7 +188,7 @@ int main(int argc, char *argv[]) {
     mpz_inits(A, mod, NULL);
 
     /* Parse command line arguments */
-    while ((opt = getopt(argc, argv, "CDn:m:a:b:i:o:")) != -1) {
+    while ((opt = getopt(argc, argv, "CDKBn:m:a:b:i:o:p:t:L:r:c:d")) != -1) {
         switch (opt) {
             case 'C':
                 cipher = 1;
@@ -32,6 +198,38 @@ int main(int argc, char *argv[]) {
                 cipher = 0;
                 break;
 
+            case 'K':
+                attack = 1;
+                break;
+
+            case 'B':
+                attack = 2;
+                break;
+
+            case 'p':
+                plain_filename = optarg;
+                break;
+
+            case 'L':
+                model_filename = optarg;
+                break;
+
+            case 'r':
+                restarts = atoi(optarg);
+                break;
+
+            case 'c':
+                ncand = atoi(optarg);
+                break;
+
+            case 'd':
+                print_plaintext = 1;
+                break;
+
+            case 't':
+                nthreads = atoi(optarg);
+                break;
+
             case 'm':
                 mod_raw = atoi(optarg);
                 break;
@@ -58,10 +256,50 @@ int main(int argc, char *argv[]) {
 
             default:
                 fprintf(stderr, "Usage: %s -C|-D -n n -m mod -a a -b b -i inputfile -o outputfile\n", argv[0]);
+                fprintf(stderr, "       %s -K -n n -m mod -p plainfile -i cipherfile [-t threads] [-o outputfile]\n", argv[0]);
+                fprintf(stderr, "       %s -B -n n [-m 26] -L modelfile [-t threads] [-r restarts] [-c candidates] [-d] -i cipherfile [-o outputfile]\n", argv[0]);
+                fprintf(stderr, "       (-B takes n from 2 to %d)\n", HILL_BREAK_MAX);
                 return EXIT_FAILURE;
         }
     }
 
+    /* Known-plaintext attack: only n, mod and the two texts are needed */
+    if (attack == 1) {
+        if (plain_filename == NULL || n < 1 || mod_raw < 2 || mod_raw > 26) {
+            fprintf(stderr, "Error: The attack needs -n, -p plainfile and a mod in 2..26.\n");
+            return EXIT_FAILURE;
+        }
+        return known_plaintext_attack(plain_filename, input_filename, output_filename, n, mod_raw, nthreads);
+    }
+
+    /* Ciphertext-only attack: the language models are mod 26, and unigrams
+     * alone cannot tell the order of the letters in a block */
+    if (attack == 2) {
+        LANG_MODEL model;
+        int status;
+
+        if (n < 2 || (mod_raw != -1 && mod_raw != 26) || restarts < 1 || ncand < 1 || model_filename == NULL) {
+            fprintf(stderr, "Error: The attack needs -n of at least 2, mod 26, -L modelfile and positive -r and -c.\n");
+            return EXIT_FAILURE;
+        }
+        if (n > HILL_BREAK_MAX) {
+            fprintf(stderr, "Error: The ciphertext-only attack only handles n up to %d.\n", HILL_BREAK_MAX);
+            return EXIT_FAILURE;
+        }
+        if (lang_model_load(&model, model_filename) != 0) {
+            perror("Error loading model file");
+            return EXIT_FAILURE;
+        }
+        if (model.quadgram_log == NULL) {
+            fprintf(stderr, "Error: The model has no quadgrams.\n");
+            lang_model_close(&model);
+            return EXIT_FAILURE;
+        }
+        status = ciphertext_only_attack(input_filename, output_filename, n, &model, nthreads, restarts, ncand, print_plaintext);
+        lang_model_close(&model);
+        return status;
+    }
+
     /* Validate required arguments */
     if (cipher == -1 || mod_raw == -1 || a_str == NULL || b_str == NULL || n == -1) {
         fprintf(stderr, "Error: Missing or invalid arguments.\n");
@@ -77,11 +315,6 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
 
-    if (n != 2) {
-        fprintf(stderr, "Error: Block size n= %d is not supported yet.\n", n);
-        return EXIT_FAILURE;
-    }
-
     int *a = malloc(n * n * sizeof(int));
     int *b = malloc(n * sizeof(int));
 
@@ -122,100 +355,16 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
 
-    /*Open the input file for reading*/
-    size_t bytes_read = 0;
-    char * buffer = NULL; 
-
-    if (input_filename == NULL) {
-        /* Leer desde stdin */
-        size_t capacity = 1024;
-        buffer = malloc(capacity);
-        int c;
-        while ((c = fgetc(stdin)) != EOF) {
-            if (bytes_read + 1 >= capacity) {
-                capacity *= 2;
-                buffer = realloc(buffer, capacity);
-                if (!buffer) {
-                    perror("realloc");
-                    return EXIT_FAILURE;
-                }
-            }
-            buffer[bytes_read++] = (char)c;
-        }
-        buffer[bytes_read] = '\0';
-    } else {
-        /* Leer desde archivo */
-        FILE *input_file = fopen(input_filename, "rb");
+    /*Open input and output files*/
+    FILE *input_file = stdin;
+    if (input_filename != NULL) {
+        input_file = fopen(input_filename, "rb");
         if (input_file == NULL) {
             perror("Error opening input file");
             return EXIT_FAILURE;
         }
-
-        fseek(input_file, 0, SEEK_END);
-        bytes_read = ftell(input_file);
-        rewind(input_file);
-
-        buffer = malloc(bytes_read + 1);
-        if (fread(buffer, 1, bytes_read, input_file) != bytes_read) {
-            perror("Error reading file");
-            fclose(input_file);
-            free(buffer);
-            return EXIT_FAILURE;
-        }
-        buffer[bytes_read] = '\0';
-        
-        fclose(input_file);
-    }
-
-    char *text = malloc(bytes_read + 1);
-    int purged = normalize_AZ(buffer, bytes_read, text);
-    bytes_read = bytes_read - purged;
-
-    if (!cipher){
-        /*Deciphering, read padding from header*/
-        padding = text[bytes_read - 1] - 'A';
-        text[bytes_read - 1] = '\0';
-        bytes_read--;
-    }else if (cipher) {
-        padding = (n - (bytes_read % n)) % n;
-        /*Pad the buffer to be a multiple of n*/
-        if (bytes_read % n != 0) {
-            size_t new_size = bytes_read + padding;
-            text = realloc(text, new_size + 1);
-            if (text == NULL) {
-                perror("Error reallocating memory");
-                return EXIT_FAILURE;
-            }
-            char padding_char = 'A' + (padding);
-            memset(text + bytes_read, padding_char, padding);
-            bytes_read = new_size;
-            text[bytes_read] = '\0';
-        }
-    }
-
-    char *buffer2 = malloc(bytes_read + 1);
-
-    if (cipher) {
-        /*Cipher*/
-        affine_cipher_hill(text, buffer2, bytes_read, matrix, vector, n, mod);
-
-        size_t len = strlen(buffer2);
-        buffer2 = realloc(buffer2, len + 2); /* +1 para header, +1 para '\0' */
-        if (!buffer2) {
-            perror("Error reallocating memory for output buffer");
-            return 1;
-        }
-
-        buffer2[bytes_read] = 'A' + (padding);
-        buffer2[bytes_read + 1] = '\0';
-        bytes_read = len + 1;
-    }else{
-        /*Decipher*/
-        affine_decipher_hill(text, buffer2, bytes_read, matrix, vector, n, mod);
-        bytes_read -= padding;
     }
 
-    /*Open output file*/
     if (output_filename == NULL){
         output_file = stdout;
     }else{
@@ -226,10 +375,21 @@ int main(int argc, char *argv[]) {
         }
     }
 
-    fwrite(buffer2, sizeof(char), bytes_read, output_file);
-    
-    fclose(output_file);
-    free(buffer2);
+    /*Cipher or decipher chunk by chunk*/
+    int status = affine_hill_stream(input_file, output_file, matrix, vector, n, mod, cipher);
+    if (status != 0 && errno == EINVAL) {
+        fprintf(stderr, "Error: Missing padding header.\n");
+    } else if (status != 0) {
+        perror("Error processing input");
+    }
+
+    if (input_file != stdin) {
+        fclose(input_file);
+    }
+    if (fclose(output_file) != 0) {
+        perror("Error writing output file");
+        status = -1;
+    }
 
     /*free mpz*/
     for (i = 0; i < n; i++) {
@@ -245,8 +405,6 @@ int main(int argc, char *argv[]) {
     free(a);
     free(b);
     mpz_clear(A);
-    free(buffer);
-    free(text);
 
-    return EXIT_SUCCESS;
+    return (status == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <bits/getopt_core.h>
+#include "utils.h"
+
+int main(int argc, char *argv[]) {
+    int opt;
+    char *input_filename = NULL;
+    char *output_filename = NULL;
+    FILE *output_file = NULL;
+    uint32_t seed1 = 0;
+    uint32_t seed2 = 0;
+    size_t keystream_bytes = 0; /* 0 to read the bits from the input */
+    size_t max_bits = 0;        /* 0 for every available bit */
+    size_t step = 0;            /* profile sampling interval, 0 for automatic */
+
+    /* Parse command line arguments */
+    while ((opt = getopt(argc, argv, "i:o:c:d:k:n:s:")) != -1) {
+        switch (opt) {
+            case 'i':
+                input_filename = optarg;
+                break;
+            case 'o':
+                output_filename = optarg;
+                break;
+            case 'c':
+                seed1 = (uint32_t)atoi(optarg);
+                break;
+            case 'd':
+                seed2 = (uint32_t)atoi(optarg);
+                break;
+            case 'k':
+                keystream_bytes = strtoull(optarg, NULL, 10);
+                break;
+            case 'n':
+                max_bits = strtoull(optarg, NULL, 10);
+                break;
+            case 's':
+                step = strtoull(optarg, NULL, 10);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-n max bits] [-s profile step] [-i infile] [-o outfile]\n", argv[0]);
+                fprintf(stderr, "       %s -c Control seed -d Data seed -k keystream bytes [-s profile step] [-o outfile]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    char *buffer = NULL;
+    size_t bytes_read = 0;
+
+    if (keystream_bytes > 0) {
+        /* Analyse the stream cipher keystream directly */
+        SHRINKING ctx;
+
+        if (seed1 == 0 || seed2 == 0) {
+            fprintf(stderr, "Error: Seeds must be non-zero.\n");
+            return EXIT_FAILURE;
+        }
+        buffer = malloc(keystream_bytes + 1);
+        if (!buffer) {
+            perror("malloc");
+            return EXIT_FAILURE;
+        }
+        shrinking_init(&ctx, seed1, seed2);
+        shrinking_keystream_fill(&ctx, (uint8_t *)buffer, keystream_bytes);
+        bytes_read = keystream_bytes;
+    } else if (input_filename == NULL) {
+        /* Leer desde stdin */
+        size_t capacity = 1024;
+        buffer = malloc(capacity);
+        if (!buffer) {
+            perror("malloc");
+            return EXIT_FAILURE;
+        }
+
+        int c;
+        while ((c = fgetc(stdin)) != EOF) {
+            if (bytes_read + 1 >= capacity) {
+                capacity *= 2;
+                buffer = realloc(buffer, capacity);
+                if (!buffer) {
+                    perror("realloc");
+                    return EXIT_FAILURE;
+                }
+            }
+            buffer[bytes_read++] = (char)c;
+        }
+    } else {
+        /* Leer desde archivo */
+        FILE *input_file = fopen(input_filename, "rb");
+        if (input_file == NULL) {
+            perror("Error opening input file");
+            return EXIT_FAILURE;
+        }
+
+        fseek(input_file, 0, SEEK_END);
+        bytes_read = ftell(input_file);
+        rewind(input_file);
+
+        buffer = malloc(bytes_read + 1);
+        if (!buffer) {
+            perror("malloc");
+            fclose(input_file);
+            return EXIT_FAILURE;
+        }
+
+        if (fread(buffer, 1, bytes_read, input_file) != bytes_read) {
+            perror("Error reading file");
+            fclose(input_file);
+            free(buffer);
+            return EXIT_FAILURE;
+        }
+
+        fclose(input_file);
+    }
+
+    /* Bits are taken LSB first, as stream_cipher consumes the keystream */
+    size_t nbits = bytes_read * 8;
+    if (max_bits > 0 && max_bits < nbits) {
+        nbits = max_bits;
+    }
+    if (nbits == 0) {
+        fprintf(stderr, "Error: No bits to analyse.\n");
+        free(buffer);
+        return EXIT_FAILURE;
+    }
+    if (step == 0) {
+        step = (nbits + 15) / 16;
+    }
+
+    uint32_t *profile = malloc(nbits * sizeof(uint32_t));
+    if (!profile) {
+        perror("malloc");
+        free(buffer);
+        return EXIT_FAILURE;
+    }
+    size_t L = lfsr_linear_complexity((const uint8_t *)buffer, nbits, profile);
+
+    /*Open the output file for writing*/
+    if (output_filename == NULL){
+        output_file = stdout;
+    }
+    else{
+        output_file = fopen(output_filename, "w");
+        if (output_file == NULL) {
+            perror("Error opening output file");
+            free(buffer);
+            free(profile);
+            return EXIT_FAILURE;
+        }
+    }
+
+    fprintf(output_file, "====== LINEAR COMPLEXITY (BERLEKAMP-MASSEY) =====\n");
+    fprintf(output_file, "Bits analysed: %zu\n", nbits);
+    fprintf(output_file, "Linear complexity: %zu\n", L);
+    fprintf(output_file, "Expected for a random sequence: %.1f\n", nbits / 2.0);
+    fprintf(output_file, "\n");
+    fprintf(output_file, "Complexity profile (bits: L(bits) / bits):\n");
+    for (size_t i = step; i < nbits; i += step) {
+        fprintf(output_file, "%12zu: %10u  %.4f\n", i, profile[i - 1], (double)profile[i - 1] / i);
+    }
+    fprintf(output_file, "%12zu: %10zu  %.4f\n", nbits, L, (double)L / nbits);
+
+    fclose(output_file);
+    free(buffer);
+    free(profile);
+
+    return EXIT_SUCCESS;
+}
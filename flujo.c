@@ -4,7 +4,253 @@
 #include <unistd.h>
 #include <bits/getopt_core.h>
 #include <math.h>
+#include <time.h>
 #include "utils.h"
+#include "shrinking.h"
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Parses "lo:hi" (inclusive) or a single seed */
+static int parse_range(const char *str, uint32_t *lo, uint32_t *hi) {
+    char *end;
+
+    *lo = (uint32_t)strtoul(str, &end, 10);
+    *hi = *lo;
+    if (*end == ':') {
+        *hi = (uint32_t)strtoul(end + 1, &end, 10);
+    }
+    return (*end == '\0' && *lo <= *hi) ? 0 : -1;
+}
+
+/* Reads a whole file, returns NULL on error */
+static char *read_file(const char *filename, size_t *length) {
+    FILE *f = fopen(filename, "rb");
+    char *data;
+
+    if (f == NULL) {
+        perror("Error opening input file");
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    *length = ftell(f);
+    rewind(f);
+
+    data = malloc(*length + 1);
+    if (!data || fread(data, 1, *length, f) != *length) {
+        perror("Error reading file");
+        fclose(f);
+        free(data);
+        return NULL;
+    }
+    data[*length] = '\0';
+    fclose(f);
+    return data;
+}
+
+/* Saves the search so it can be resumed with -R */
+static void save_checkpoint(const SHRINKING_SEARCH *search, const char *filename) {
+    char tmp[4096];
+    FILE *f;
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", filename);
+    f = fopen(tmp, "w");
+    if (f == NULL) {
+        perror("Error writing checkpoint");
+        return;
+    }
+    fprintf(f, "%u %u %u %u %llu\n", search->c_lo, search->c_hi, search->d_lo, search->d_hi,
+            (unsigned long long)search->next);
+    fclose(f);
+    rename(tmp, filename);
+}
+
+static void attack_progress(const SHRINKING_SEARCH *search, double keys_per_second, void *arg) {
+    const char *checkpoint = arg;
+
+    fprintf(stderr, "\rExplored %llu/%llu pairs (%.2f%%), %.3e keys/s   ",
+            (unsigned long long)search->next, (unsigned long long)search->total,
+            100.0 * search->next / search->total, keys_per_second);
+    if (checkpoint != NULL) {
+        save_checkpoint(search, checkpoint);
+    }
+}
+
+/* Known-plaintext seed recovery over the -c/-d ranges */
+static int attack(const char *c_range, const char *d_range, const char *cipher_filename,
+                  const char *plain_filename, const char *checkpoint, int nthreads, FILE *out) {
+    SHRINKING_SEARCH search;
+    uint32_t c_lo, c_hi, d_lo, d_hi;
+    FILE *f;
+    size_t cipher_len, plain_len;
+
+    if (checkpoint != NULL && (f = fopen(checkpoint, "r")) != NULL) {
+        unsigned long long next;
+        /* Resume where the previous run stopped */
+        if (fscanf(f, "%u %u %u %u %llu", &c_lo, &c_hi, &d_lo, &d_hi, &next) != 5) {
+            fprintf(stderr, "Error: Invalid checkpoint file %s.\n", checkpoint);
+            fclose(f);
+            return EXIT_FAILURE;
+        }
+        fclose(f);
+        shrinking_search_init(&search, c_lo, c_hi, d_lo, d_hi);
+        search.next = next;
+    } else {
+        if (c_range == NULL || d_range == NULL
+            || parse_range(c_range, &c_lo, &c_hi) != 0 || parse_range(d_range, &d_lo, &d_hi) != 0) {
+            fprintf(stderr, "Error: Attack needs seed ranges -c lo:hi -d lo:hi.\n");
+            return EXIT_FAILURE;
+        }
+        shrinking_search_init(&search, c_lo, c_hi, d_lo, d_hi);
+    }
+
+    if (cipher_filename == NULL || plain_filename == NULL) {
+        fprintf(stderr, "Error: Attack needs the ciphertext (-i) and known plaintext (-p) files.\n");
+        return EXIT_FAILURE;
+    }
+    char *ciphertext = read_file(cipher_filename, &cipher_len);
+    char *plaintext = read_file(plain_filename, &plain_len);
+    if (ciphertext == NULL || plaintext == NULL) {
+        free(ciphertext);
+        free(plaintext);
+        return EXIT_FAILURE;
+    }
+
+    /* Known keystream = plaintext XOR ciphertext over the common prefix */
+    size_t known_len = (cipher_len < plain_len) ? cipher_len : plain_len;
+    uint8_t *known = malloc(known_len + 1);
+    for (size_t i = 0; i < known_len; i++) {
+        known[i] = (uint8_t)(plaintext[i] ^ ciphertext[i]);
+    }
+
+    shrinking_search(&search, known, known_len, nthreads, attack_progress, (void *)checkpoint);
+    fprintf(stderr, "\n");
+
+    fprintf(out, "====== SHRINKING GENERATOR SEED SEARCH =====\n");
+    fprintf(out, "Known keystream bytes: %zu\n", known_len);
+    if (search.found) {
+        fprintf(out, "Seeds found: -c %u -d %u\n", search.seed1, search.seed2);
+    } else {
+        fprintf(out, "No seeds found in -c %u:%u -d %u:%u.\n", search.c_lo, search.c_hi, search.d_lo, search.d_hi);
+    }
+
+    free(known);
+    free(ciphertext);
+    free(plaintext);
+
+    return search.found ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* Throughput benchmark of the bit-serial and word-at-a-time LFSR engines */
+static int benchmark(uint64_t nbits, FILE *out) {
+    LFSR serial, word, jump;
+    LFSR_TABLE table;
+    uint64_t check_serial = 0, check_word = 0;
+    double t0, t1, t2;
+
+    nbits -= nbits % 64;
+    if (nbits == 0) {
+        fprintf(stderr, "Error: Benchmark needs at least 64 bits.\n");
+        return EXIT_FAILURE;
+    }
+
+    lfsr_init(&serial, 0x12345678u, 0xA3000000u, 32);
+    lfsr_init(&word, 0x12345678u, 0xA3000000u, 32);
+    lfsr_table_init(&table, 0xA3000000u, 32);
+
+    t0 = now_seconds();
+    for (uint64_t i = 0; i < nbits / 64; i++) {
+        uint64_t w = 0;
+        for (int bit = 0; bit < 64; bit++) {
+            w |= (uint64_t)lfsr_next_bit(&serial) << bit;
+        }
+        check_serial = check_serial * 31 + w;
+    }
+    t1 = now_seconds();
+    for (uint64_t i = 0; i < nbits / 64; i++) {
+        check_word = check_word * 31 + lfsr_next_bits(&word, &table, 64);
+    }
+    t2 = now_seconds();
+
+    /* Seeking straight to the end must land on the same state */
+    lfsr_init(&jump, 0x12345678u, 0xA3000000u, 32);
+    lfsr_jump(&jump, nbits);
+
+    fprintf(out, "====== LFSR BENCHMARK =====\n");
+    fprintf(out, "Bits generated: %llu\n", (unsigned long long)nbits);
+    fprintf(out, "lfsr_next_bit : %.3e bits/s\n", nbits / (t1 - t0));
+    fprintf(out, "lfsr_next_bits: %.3e bits/s\n", nbits / (t2 - t1));
+    fprintf(out, "Outputs match : %s\n", (check_serial == check_word && serial.state == word.state) ? "yes" : "NO");
+    fprintf(out, "lfsr_jump     : %s\n", (jump.state == serial.state) ? "yes" : "NO");
+
+
+    /* Keystream buffer API against the bit-by-bit shrinking generator */
+    size_t ks_bytes = nbits / 64;
+    uint8_t *ks_fill = malloc(ks_bytes);
+    uint8_t *ks_bit = malloc(ks_bytes);
+    SHRINKING ctx;
+    LFSR r1, r2;
+
+    lfsr_init(&r1, 0x12345678u, STREAM_MASK1, 32);
+    lfsr_init(&r2, 0x9ABCDEF0u, STREAM_MASK2, 32);
+    t0 = now_seconds();
+    for (size_t i = 0; i < ks_bytes; i++) {
+        uint8_t key_byte = 0;
+        for (int bit = 0; bit < 8; bit++) {
+            key_byte |= shrinking_bit(&r1, &r2) << bit;
+        }
+        ks_bit[i] = key_byte;
+    }
+    t1 = now_seconds();
+    shrinking_init(&ctx, 0x12345678u, 0x9ABCDEF0u);
+    shrinking_keystream_fill(&ctx, ks_fill, ks_bytes);
+    t2 = now_seconds();
+    int fill_ok = (memcmp(ks_fill, ks_bit, ks_bytes) == 0);
+
+    fprintf(out, "shrinking_bit : %.3e keystream bits/s\n", ks_bytes * 8 / (t1 - t0));
+    fprintf(out, "keystream_fill: %.3e keystream bits/s\n", ks_bytes * 8 / (t2 - t1));
+    fprintf(out, "Fill matches  : %s\n", fill_ok ? "yes" : "NO");
+    free(ks_fill);
+    free(ks_bit);
+
+    /* Bit-sliced batch, checked lane by lane against stream_cipher over zeros */
+    size_t count = 256, nbytes = (nbits / 8 + count - 1) / count;
+    uint32_t *seeds1 = malloc(count * sizeof(uint32_t));
+    uint32_t *seeds2 = malloc(count * sizeof(uint32_t));
+    uint8_t *batch = malloc(count * nbytes);
+    char *zeros = calloc(nbytes, 1);
+    char *single = malloc(nbytes);
+    int batch_ok = 1;
+
+    for (size_t k = 0; k < count; k++) {
+        seeds1[k] = 0x9E3779B9u * (uint32_t)(k + 1);
+        seeds2[k] = 0x7F4A7C15u * (uint32_t)(k + 3);
+    }
+    t0 = now_seconds();
+    shrinking_batch(seeds1, seeds2, count, batch, nbytes);
+    t1 = now_seconds();
+    for (size_t k = 0; k < count; k++) {
+        stream_cipher(zeros, single, nbytes, seeds1[k], seeds2[k]);
+        if (memcmp(single, batch + k * nbytes, nbytes) != 0) {
+            batch_ok = 0;
+        }
+    }
+    t2 = now_seconds();
+
+    fprintf(out, "shrinking_batch: %.3e keystream bits/s (%zu seed pairs)\n", count * nbytes * 8 / (t1 - t0), count);
+    fprintf(out, "Lanes match   : %s\n", batch_ok ? "yes" : "NO");
+
+    free(seeds1);
+    free(seeds2);
+    free(batch);
+    free(zeros);
+    free(single);
+
+    return (check_serial == check_word && jump.state == serial.state && fill_ok && batch_ok) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
 
 
 int main(int argc, char *argv[]) {
@@ -16,10 +262,16 @@ int main(int argc, char *argv[]) {
     int m = -1;
     uint32_t seed1 = 0;
     uint32_t seed2 = 0;
+    uint64_t bench_bits = 0;
+    int attack_mode = 0;
+    char *c_arg = NULL, *d_arg = NULL;
+    char *plain_filename = NULL;
+    char *checkpoint_filename = NULL;
+    int nthreads = 0; /* 0 for one thread per core */
 
 
     /* Parse command line arguments */
-    while ((opt = getopt(argc, argv, "CDi:o:c:d:m:")) != -1){
+    while ((opt = getopt(argc, argv, "CDAi:o:c:d:m:t:p:R:B:")) != -1){
 
         switch (opt) {
             case 'C':
@@ -28,12 +280,23 @@ int main(int argc, char *argv[]) {
             case 'D':
                 cipher = 0;
                 break;
+            case 'A':
+                attack_mode = 1;
+                break;
             case 'c':
+                c_arg = optarg;
                 seed1 = (uint32_t)atoi(optarg);
                 break;
             case 'd':
+                d_arg = optarg;
                 seed2 = (uint32_t)atoi(optarg);
                 break;
+            case 'p':
+                plain_filename = optarg;
+                break;
+            case 'R':
+                checkpoint_filename = optarg;
+                break;
             case 'i':
                 input_filename = optarg;
                 break;
@@ -43,15 +306,45 @@ int main(int argc, char *argv[]) {
             case 'm':
                 m = atoi(optarg);
                 break;
+            case 't':
+                nthreads = atoi(optarg);
+                break;
+            case 'B':
+                bench_bits = strtoull(optarg, NULL, 10);
+                break;
             default:
-                fprintf(stderr, "Usage: %s -C|-D [-c Control seed] [-d Data seed] [-m mod] [-i infile] [-o outfile]\n", argv[0]);
+                fprintf(stderr, "Usage: %s -C|-D [-c Control seed] [-d Data seed] [-m mod] [-t threads] [-i infile] [-o outfile]\n", argv[0]);
+                fprintf(stderr, "       %s -A -c lo:hi -d lo:hi -p plainfile -i cipherfile [-R checkpoint] [-t threads] [-o outfile]\n", argv[0]);
+                fprintf(stderr, "       %s -B bits (benchmark)\n", argv[0]);
                 return EXIT_FAILURE;
         }
     }
 
+    if (bench_bits > 0) {
+        return benchmark(bench_bits, stdout);
+    }
+
+    if (attack_mode) {
+        if (m != -1) {
+            fprintf(stderr, "Error: The seed search only supports the XOR cipher (no -m).\n");
+            return EXIT_FAILURE;
+        }
+        if (nthreads <= 0) {
+            nthreads = default_threads();
+        }
+        output_file = stdout;
+        if (output_filename != NULL && (output_file = fopen(output_filename, "w")) == NULL) {
+            perror("Error opening output file");
+            return EXIT_FAILURE;
+        }
+        int status = attack(c_arg, d_arg, input_filename, plain_filename, checkpoint_filename, nthreads, output_file);
+        fclose(output_file);
+        return status;
+    }
+
     if (cipher == -1) {
         fprintf(stderr, "Error: Missing or invalid arguments.\n");
-        fprintf(stderr, "Usage: %s -C|-D [-c Control seed] [-d Data seed] [-m mod] [-i infile] [-o outfile]\n", argv[0]);
+        fprintf(stderr, "Usage: %s -C|-D [-c Control seed] [-d Data seed] [-m mod] [-t threads] [-i infile] [-o outfile]\n", argv[0]);
         return EXIT_FAILURE;
     }
 
@@ -122,17 +415,16 @@ int main(int argc, char *argv[]) {
         bytes_read = bytes_read - purged;
     }
 
+    if (nthreads <= 0) {
+        nthreads = default_threads();
+    }
+
     char *buffer2 = malloc(bytes_read + 1);
     if(m == -1){
         memcpy(text, buffer, bytes_read);
-        stream_cipher(text, buffer2, bytes_read, seed1, seed2);
-    }else{
-        if (cipher == 1){
-            stream_cipher_mod(text, buffer2, bytes_read, seed1, seed2, m);
-        }else{
-            stream_decipher_mod(text, buffer2, bytes_read, seed1, seed2, m);
-        }
     }
+    /* Same output as stream_cipher / stream_cipher_mod / stream_decipher_mod */
+    stream_cipher_parallel(text, buffer2, bytes_read, seed1, seed2, m, cipher, nthreads);
         
 
     /*Open the output file for writing*/
@@ -0,0 +1,967 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hill.h"
+
+uint32_t hill_inv_u32(uint32_t x, uint32_t m){
+    int64_t r0 = m, r1 = x % m, t0 = 0, t1 = 1;
+
+    while (r1 != 0) {
+        int64_t q = r0 / r1, r2 = r0 - q * r1, t2 = t0 - q * t1;
+        r0 = r1;
+        r1 = r2;
+        t0 = t1;
+        t1 = t2;
+    }
+    if (r0 != 1 || m == 1)
+        return 0;
+    return (uint32_t)(t0 < 0 ? t0 + m : t0);
+}
+
+/* row[k] -= f * pivot[k] mod m for k in [from, cols) */
+static inline void row_sub(uint32_t *row, const uint32_t *pivot, uint32_t f, int from, int cols, uint32_t m){
+    uint64_t g = (m - f % m) % m;
+
+    if (g == 0)
+        return;
+    for (int k = from; k < cols; k++)
+        row[k] = (uint32_t)((row[k] + g * pivot[k]) % m);
+}
+
+/* Brings the rows (cols wide) to upper triangular form in column order.
+ * A unit pivot eliminates the column in one pass; otherwise pairs of rows
+ * are reduced by the Euclidean algorithm on their leading entries, so the
+ * gcd ends up on the diagonal. Returns the number of row swaps, mod 2. */
+static int triangulate(uint32_t **rows, int n, int cols, uint32_t m){
+    int swaps = 0;
+
+    for (int c = 0; c < n; c++) {
+        uint32_t inv = 0;
+        int r;
+
+        /* Prefer a unit pivot */
+        for (r = c; r < n; r++) {
+            if (rows[r][c] != 0 && (inv = hill_inv_u32(rows[r][c], m)) != 0)
+                break;
+        }
+        if (r < n) {
+            if (r != c) {
+                uint32_t *t = rows[r];
+                rows[r] = rows[c];
+                rows[c] = t;
+                swaps ^= 1;
+            }
+            for (r = c + 1; r < n; r++) {
+                if (rows[r][c] != 0)
+                    row_sub(rows[r], rows[c], (uint32_t)((uint64_t)rows[r][c] * inv % m), c, cols, m);
+            }
+            continue;
+        }
+
+        for (r = c + 1; r < n; r++) {
+            while (rows[r][c] != 0) {
+                uint32_t *t;
+
+                row_sub(rows[c], rows[r], rows[c][c] / rows[r][c], c, cols, m);
+                t = rows[r];
+                rows[r] = rows[c];
+                rows[c] = t;
+                swaps ^= 1;
+            }
+        }
+    }
+    return swaps;
+}
+
+/* n row pointers into a fresh copy of a, cols wide (extra columns zero) */
+static uint32_t **copy_rows(const uint32_t *a, int n, int cols){
+    uint32_t **rows = malloc(n * sizeof(uint32_t *) + (size_t)n * cols * sizeof(uint32_t));
+    uint32_t *data;
+
+    if (!rows)
+        return NULL;
+    data = (uint32_t *)(rows + n);
+    memset(data, 0, (size_t)n * cols * sizeof(uint32_t));
+    for (int i = 0; i < n; i++) {
+        rows[i] = data + (size_t)i * cols;
+        memcpy(rows[i], a + (size_t)i * n, n * sizeof(uint32_t));
+    }
+    return rows;
+}
+
+uint32_t hill_det_mod(const uint32_t *a, int n, uint32_t m){
+    uint32_t **rows;
+    uint64_t det = 1 % m;
+    int swaps;
+
+    if (m <= 1 || (rows = copy_rows(a, n, n)) == NULL)
+        return 0;
+    swaps = triangulate(rows, n, n, m);
+    for (int i = 0; i < n; i++)
+        det = det * rows[i][i] % m;
+    free(rows);
+    return (uint32_t)((swaps && det) ? m - det : det);
+}
+
+int hill_inverse_mod(const uint32_t *a, uint32_t *inv, int n, uint32_t m){
+    int cols = 2 * n;
+    uint32_t **rows;
+
+    memset(inv, 0, (size_t)n * n * sizeof(uint32_t));
+    if (m <= 1 || (rows = copy_rows(a, n, cols)) == NULL)
+        return -1;
+
+    /* [A | I] -> [U | L] -> [I | A^-1]. The diagonal of U multiplies to
+     * +-det, so with a unit determinant every diagonal entry is a unit. */
+    for (int i = 0; i < n; i++)
+        rows[i][n + i] = 1;
+    triangulate(rows, n, cols, m);
+
+    for (int c = n - 1; c >= 0; c--) {
+        uint32_t d = hill_inv_u32(rows[c][c], m);
+
+        if (d == 0) {
+            free(rows);
+            return -1;
+        }
+        for (int k = c; k < cols; k++)
+            rows[c][k] = (uint32_t)((uint64_t)rows[c][k] * d % m);
+        for (int r = 0; r < c; r++) {
+            if (rows[r][c] != 0)
+                row_sub(rows[r], rows[c], rows[r][c], c, cols, m);
+        }
+    }
+
+    for (int i = 0; i < n; i++)
+        memcpy(inv + (size_t)i * n, rows[i] + n, n * sizeof(uint32_t));
+    free(rows);
+    return 0;
+}
+
+/* Blocks multiplied at a time: the n x HILL_TILE tile of X stays in cache */
+#define HILL_TILE 256
+
+/* Sixteen bytes at a time, lowered to whatever vector unit the target has */
+typedef unsigned char v16u8 __attribute__((vector_size(16)));
+
+static inline v16u8 load16(const void *p){
+    v16u8 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void store16(void *p, v16u8 v){
+    memcpy(p, &v, sizeof(v));
+}
+
+/* Value of each byte of a tile as a letter, 0 for anything but 'A'..'Z' and
+ * for the missing tail of a short last block */
+static void letter_values(const unsigned char *in, size_t bytes, size_t padded, unsigned char *v){
+    size_t p = 0;
+
+    for (; p + 16 <= bytes; p += 16) {
+        v16u8 c = load16(in + p) - 'A';
+        store16(v + p, c & (v16u8)(c < 26));
+    }
+    for (; p < bytes; p++) {
+        unsigned char c = in[p] - 'A';
+        v[p] = (c < 26) ? c : 0;
+    }
+    memset(v + bytes, 0, padded - bytes);
+}
+
+/* Letters become the result byte, anything else is copied through */
+static void merge_output(const unsigned char *in, const unsigned char *y, size_t bytes, char *out){
+    size_t p = 0;
+
+    for (; p + 16 <= bytes; p += 16) {
+        v16u8 raw = load16(in + p);
+        v16u8 letter = (v16u8)(raw - 'A' < 26);
+        store16(out + p, (load16(y + p) & letter) | (raw & ~letter));
+    }
+    for (; p < bytes; p++) {
+        unsigned char c = in[p] - 'A';
+        out[p] = (char)((c < 26) ? y[p] : in[p]);
+    }
+}
+
+/* Division by m of every sum up to limit as a 16-bit multiply-high and a
+ * shift, q = (acc * mul) >> (16 + shift). Returns -1 if no such pair is
+ * exact over the whole range. */
+static int magic16(uint32_t m, uint32_t limit, uint16_t *mul, int *shift){
+    for (int s = 0; s < 16; s++) {
+        uint32_t M = (uint32_t)(((UINT64_C(1) << (16 + s)) + m - 1) / m);
+        uint32_t a;
+
+        if (M > UINT16_MAX)
+            break;
+        for (a = 0; a <= limit; a++) {
+            if (((a * M) >> (16 + s)) != a / m)
+                break;
+        }
+        if (a > limit) {
+            *mul = (uint16_t)M;
+            *shift = s;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* acc mod m for every lane */
+static void reduce16(uint16_t *acc, uint16_t m, uint16_t mul, int shift){
+    for (size_t j = 0; j < HILL_TILE; j++) {
+        uint16_t q = (uint16_t)(((uint32_t)acc[j] * mul) >> 16) >> shift;
+        acc[j] -= q * m;
+    }
+}
+
+int hill_affine_AZ(const char *input, char *output, size_t length, const uint32_t *a, const uint32_t *b, int n, uint32_t m){
+    size_t tile = (size_t)n * HILL_TILE;
+    unsigned char *v = malloc(2 * tile);
+    unsigned char *y = v ? v + tile : NULL;
+    uint16_t *x = calloc(tile, sizeof(uint16_t));
+    /* Letters are 0..25 (never reduced), so every term is below term */
+    uint64_t term = (uint64_t)(m - 1) * 25;
+    /* Sums are kept in 16 bits, or 64 for large moduli, and reduced only
+     * when the next `every` terms could overflow them */
+    int wide = (term + m - 1 > UINT16_MAX);
+    uint64_t every = term ? ((wide ? UINT64_MAX : UINT16_MAX) - (m - 1)) / term : UINT64_MAX;
+    uint16_t mul = 0;
+    int shift = 0;
+
+    /* Sums in 16 bits need an exact reciprocal for m */
+    if (!wide) {
+        uint64_t limit = (m - 1) + (every < (uint64_t)n ? every : (uint64_t)n) * term;
+        wide = (magic16(m, (uint32_t)limit, &mul, &shift) != 0);
+        if (wide)
+            every = term ? (UINT64_MAX - (m - 1)) / term : UINT64_MAX;
+    }
+
+    if (!v || !x) {
+        free(v);
+        free(x);
+        return -1;
+    }
+
+    for (size_t base = 0; base < length; base += tile) {
+        size_t bytes = (length - base < tile) ? length - base : tile;
+        size_t blocks = (bytes + n - 1) / n;
+        const unsigned char *in = (const unsigned char *)input + base;
+
+        /* X: column j is block j, row k its letter k */
+        letter_values(in, bytes, blocks * n, v);
+        for (size_t j = 0; j < blocks; j++) {
+            for (int k = 0; k < n; k++)
+                x[(size_t)k * HILL_TILE + j] = v[j * n + k];
+        }
+
+        for (int i = 0; i < n; i++) {
+            const uint32_t *row = a + (size_t)i * n;
+
+            if (!wide) {
+                uint16_t acc[HILL_TILE];
+
+                for (size_t j = 0; j < HILL_TILE; j++)
+                    acc[j] = (uint16_t)b[i];
+                for (int k = 0; k < n; k++) {
+                    const uint16_t *xk = x + (size_t)k * HILL_TILE;
+                    uint16_t f = (uint16_t)row[k];
+                    for (size_t j = 0; j < HILL_TILE; j++)
+                        acc[j] += f * xk[j];
+                    if ((uint64_t)(k + 1) % every == 0)
+                        reduce16(acc, (uint16_t)m, mul, shift);
+                }
+                reduce16(acc, (uint16_t)m, mul, shift);
+                for (size_t j = 0; j < blocks; j++)
+                    y[j * n + i] = (unsigned char)(acc[j] + 'A');
+            } else {
+                uint64_t acc[HILL_TILE];
+
+                for (size_t j = 0; j < HILL_TILE; j++)
+                    acc[j] = b[i];
+                for (int k = 0; k < n; k++) {
+                    const uint16_t *xk = x + (size_t)k * HILL_TILE;
+                    uint64_t f = row[k];
+                    for (size_t j = 0; j < HILL_TILE; j++)
+                        acc[j] += f * xk[j];
+                    if ((uint64_t)(k + 1) % every == 0) {
+                        for (size_t j = 0; j < HILL_TILE; j++)
+                            acc[j] %= m;
+                    }
+                }
+                for (size_t j = 0; j < blocks; j++)
+                    y[j * n + i] = (unsigned char)(acc[j] % m + 'A');
+            }
+        }
+        merge_output(in, y, bytes, output + base);
+    }
+    output[length] = '\0';
+    free(v);
+    free(x);
+    return 0;
+}
+
+/* Blocks checked before a candidate key is verified over the whole text */
+#define KPA_SAMPLE 32
+/* Block subsets tried at most */
+#define KPA_MAX_TRIALS (1 << 16)
+/* Bytes per verification pass of hill_affine_AZ */
+#define KPA_VERIFY_CHUNK (1 << 16)
+
+/* Known-plaintext search shared by the threads */
+typedef struct {
+    const char *plain;
+    const char *cipher;
+    size_t blocks;         /* whole blocks present in both texts */
+    int n;
+    uint32_t m;
+    uint64_t trials;       /* block subsets tried at most */
+    int nthreads;
+    pthread_mutex_t lock;
+    int found;
+    uint64_t winner;       /* trial that gave the key */
+    uint32_t *key;         /* A (n x n) then b */
+} KPA_SEARCH;
+
+typedef struct {
+    KPA_SEARCH *s;
+    int id;
+} KPA_WORKER;
+
+/* Runs fn on every worker: thread 0 is the caller, a thread that fails to
+ * start runs inline */
+static void run_workers(void *(*fn)(void *), void *workers, size_t size, int nthreads, pthread_t *threads, int *started){
+    char *w = workers;
+
+    for (int t = 0; t < nthreads; t++)
+        started[t] = (t > 0 && pthread_create(&threads[t], NULL, fn, w + t * size) == 0);
+    for (int t = 0; t < nthreads; t++) {
+        if (!started[t])
+            fn(w + t * size);
+    }
+    for (int t = 1; t < nthreads; t++) {
+        if (started[t])
+            pthread_join(threads[t], NULL);
+    }
+}
+
+/* Letter value of a text byte, reduced mod m */
+static inline uint32_t kpa_value(char c, uint32_t m){
+    return (uint32_t)(c - 'A') % m;
+}
+
+/* True if key maps block j of the plaintext to block j of the ciphertext */
+static int kpa_block_ok(const KPA_SEARCH *s, const uint32_t *key, size_t j){
+    int n = s->n;
+    const char *x = s->plain + j * n;
+    const char *y = s->cipher + j * n;
+
+    for (int i = 0; i < n; i++) {
+        uint64_t acc = key[(size_t)n * n + i];
+        for (int k = 0; k < n; k++)
+            acc = (acc + (uint64_t)key[(size_t)i * n + k] * kpa_value(x[k], s->m)) % s->m;
+        if (acc != kpa_value(y[i], s->m))
+            return 0;
+    }
+    return 1;
+}
+
+/* Ciphers the whole plaintext with key and compares, chunk by chunk */
+static int kpa_verify(const KPA_SEARCH *s, const uint32_t *key){
+    size_t total = s->blocks * s->n;
+    size_t chunk = KPA_VERIFY_CHUNK - KPA_VERIFY_CHUNK % s->n;
+    char *out = malloc(chunk + 1);
+    int ok = (out != NULL);
+
+    for (size_t p = 0; ok && p < total; p += chunk) {
+        size_t len = (total - p < chunk) ? total - p : chunk;
+        ok = (hill_affine_AZ(s->plain + p, out, len, key, key + (size_t)s->n * s->n, s->n, s->m) == 0
+              && memcmp(out, s->cipher + p, len) == 0);
+    }
+    free(out);
+    return ok;
+}
+
+/* Solves [A | b] from the n+1 blocks of trial t: with X the matrix whose
+ * columns are the plaintext blocks topped up with a 1, and Y the matching
+ * ciphertext blocks, [A | b] X = Y, so [A | b] = Y X^-1. Returns -1 when
+ * the blocks of this trial do not give an invertible X. */
+static int kpa_solve(const KPA_SEARCH *s, uint64_t t, uint32_t *x, uint32_t *xinv, uint32_t *key){
+    int n = s->n, d = n + 1;
+    size_t start = t % s->blocks;
+    size_t step = 1 + (t / s->blocks) % (s->blocks > 1 ? s->blocks - 1 : 1);
+    uint32_t m = s->m;
+
+    for (int c = 0; c < d; c++) {
+        size_t j = (start + c * step) % s->blocks;
+        for (int r = 0; r < n; r++)
+            x[r * d + c] = kpa_value(s->plain[j * n + r], m);
+        x[n * d + c] = 1 % m;
+    }
+    if (hill_inverse_mod(x, xinv, d, m) != 0)
+        return -1;
+
+    for (int i = 0; i < n; i++) {
+        for (int c = 0; c < d; c++) {
+            uint64_t acc = 0;
+            for (int k = 0; k < d; k++) {
+                size_t j = (start + k * step) % s->blocks;
+                acc = (acc + (uint64_t)kpa_value(s->cipher[j * n + i], m) * xinv[k * d + c]) % m;
+            }
+            /* Column c < n is A's, column n is b */
+            if (c < n)
+                key[(size_t)i * n + c] = (uint32_t)acc;
+            else
+                key[(size_t)n * n + i] = (uint32_t)acc;
+        }
+    }
+    return 0;
+}
+
+static void *kpa_worker(void *arg){
+    KPA_WORKER *w = arg;
+    KPA_SEARCH *s = w->s;
+    int n = s->n, d = n + 1;
+    uint32_t *x = malloc(2 * (size_t)d * d * sizeof(uint32_t));
+    uint32_t *key = malloc(((size_t)n * n + n) * sizeof(uint32_t));
+
+    /* Trials are dealt round-robin; stop as soon as anyone has a key */
+    for (uint64_t t = w->id; x && key && t < s->trials; t += s->nthreads) {
+        int ok = 1;
+
+        if (__atomic_load_n(&s->found, __ATOMIC_RELAXED))
+            break;
+        if (kpa_solve(s, t, x, x + (size_t)d * d, key) != 0)
+            continue;
+        for (size_t k = 0; ok && k < KPA_SAMPLE && k < s->blocks; k++)
+            ok = kpa_block_ok(s, key, (t + k * 7919) % s->blocks);
+        if (!ok || !kpa_verify(s, key))
+            continue;
+
+        pthread_mutex_lock(&s->lock);
+        if (!s->found || t < s->winner) {
+            memcpy(s->key, key, ((size_t)n * n + n) * sizeof(uint32_t));
+            s->winner = t;
+            __atomic_store_n(&s->found, 1, __ATOMIC_RELAXED);
+        }
+        pthread_mutex_unlock(&s->lock);
+        break;
+    }
+    free(x);
+    free(key);
+    return NULL;
+}
+
+int hill_known_plaintext(const char *plain, const char *cipher, size_t length, int n, uint32_t m, int nthreads, uint32_t *key, uint64_t *trial){
+    KPA_SEARCH s;
+    pthread_t *threads;
+    KPA_WORKER *workers;
+    int *started;
+
+    if (n < 1 || m < 2 || length / n == 0)
+        return -1;
+    if (nthreads < 1)
+        nthreads = 1;
+
+    s.plain = plain;
+    s.cipher = cipher;
+    s.blocks = length / n;
+    s.n = n;
+    s.m = m;
+    /* Every start block with every stride, up to KPA_MAX_TRIALS */
+    s.trials = (uint64_t)s.blocks * (s.blocks > 1 ? s.blocks - 1 : 1);
+    if (s.trials > KPA_MAX_TRIALS)
+        s.trials = KPA_MAX_TRIALS;
+    s.nthreads = nthreads;
+    s.found = 0;
+    s.winner = 0;
+    s.key = key;
+    pthread_mutex_init(&s.lock, NULL);
+
+    threads = malloc(nthreads * sizeof(pthread_t));
+    workers = malloc(nthreads * sizeof(KPA_WORKER));
+    started = calloc(nthreads, sizeof(int));
+    if (!threads || !workers || !started) {
+        free(threads);
+        free(workers);
+        free(started);
+        pthread_mutex_destroy(&s.lock);
+        return -1;
+    }
+
+    for (int t = 0; t < nthreads; t++) {
+        workers[t].s = &s;
+        workers[t].id = t;
+    }
+    run_workers(kpa_worker, workers, sizeof(KPA_WORKER), nthreads, threads, started);
+
+    if (trial)
+        *trial = s.winner;
+    free(threads);
+    free(workers);
+    free(started);
+    pthread_mutex_destroy(&s.lock);
+    return s.found ? 0 : -1;
+}
+
+/* Ciphertext-only attack, mod 26. Keys are searched in deciphering form
+ * x = D y + e (D = A^-1, e = -A^-1 b), which is what gets applied to the
+ * sample, and turned into A and b at the end. A row (d, e_i) of the key
+ * alone gives the letters at position i of every block, so rows are first
+ * ranked on their own by the unigram fit of those letters and then
+ * combined into keys. Past HILL_BREAK_EXHAUSTIVE there are too many rows to
+ * score, and 26 = 2 * 13 is used instead: the row mod 13 already fixes the
+ * letters mod 13, which are far from uniform in the language, so rows are
+ * searched mod 13 and the best ones lifted to mod 26 with every row mod 2. */
+
+#define HB_MOD 26
+#define HB_MOD13 13
+/* Rows mod 13 lifted to mod 26 */
+#define HB_ROWS13 100
+/* Coordinate sweeps at most per hill-climbing restart */
+#define HB_SWEEPS 50
+
+typedef struct {
+    const char *sample;    /* first whole blocks of the ciphertext */
+    size_t length;
+    const unsigned char *y; /* letter values of the sample */
+    int n;
+    const LANG_MODEL *model;
+    double ulog[HB_MOD];   /* unigram log10 probabilities of the model */
+    const unsigned char *ry;   /* letters the rows of larger keys are found on */
+    const unsigned char *ry13; /* and the same mod 13 */
+    size_t rblocks;
+    double ulog13[HB_MOD13];   /* log10 probabilities of the letters mod 13 */
+    const uint32_t *rows13;    /* ranked rows mod 13 */
+    int nrows13;
+    int nthreads;
+    const uint32_t *rows;  /* ranked rows (d, e), n + 1 entries each */
+    int nrows;
+    int restarts;
+    int failed;            /* set when a key could not be applied */
+} HB_SEARCH;
+
+/* A worker and its best keys so far */
+typedef struct {
+    HB_SEARCH *s;
+    int id;
+    size_t k;              /* entries of a key */
+    int cap;
+    uint32_t *keys;
+    double *scores;
+    int count;
+} HB_WORKER;
+
+/* True if D is invertible mod 26 */
+static int hb_unit(const uint32_t *key, int n){
+    return hill_inv_u32(hill_det_mod(key, n, HB_MOD), HB_MOD) != 0;
+}
+
+/* A row with every entry even or every entry a multiple of 13 cannot be
+ * part of an invertible D, and its skewed letters would score well */
+static int hb_row_ok(const uint32_t *d, int n){
+    int odd = 0, off13 = 0;
+
+    for (int k = 0; k < n; k++) {
+        odd |= d[k] % 2;
+        off13 |= (d[k] % 13 != 0);
+    }
+    return odd && off13;
+}
+
+/* Fitness of the sample deciphered with key; buf holds length + 1 bytes.
+ * Out of memory, the search is marked failed and the key scores -inf. */
+static double hb_score(HB_SEARCH *s, const uint32_t *key, char *buf){
+    if (hill_affine_AZ(s->sample, buf, s->length, key, key + (size_t)s->n * s->n, s->n, HB_MOD) != 0) {
+        __atomic_store_n(&s->failed, 1, __ATOMIC_RELAXED);
+        return -HUGE_VAL;
+    }
+    return lang_quadgram_score(s->model->quadgram_log, buf, s->length);
+}
+
+/* Counts the letters row (d, 0) gives over the sample */
+static void hb_row_hist(const HB_SEARCH *s, const uint32_t *row, uint32_t *hist){
+    size_t blocks = s->length / s->n;
+
+    memset(hist, 0, HB_MOD * sizeof(uint32_t));
+    for (size_t j = 0; j < blocks; j++) {
+        const unsigned char *y = s->y + j * s->n;
+        uint32_t x = 0;
+        for (int k = 0; k < s->n; k++)
+            x += row[k] * y[k];
+        hist[x % HB_MOD]++;
+    }
+}
+
+/* Unigram fit of the letters row (d, e) gives, from the counts of (d, 0) */
+static double hb_shift_score(const HB_SEARCH *s, const uint32_t *hist, uint32_t e){
+    double score = 0.0;
+
+    for (int x = 0; x < HB_MOD; x++)
+        score += hist[x] * s->ulog[(x + e) % HB_MOD];
+    return score;
+}
+
+/* Inserts a key into the worker's list, best first, unless it is already
+ * there or worse than all of a full list */
+static void hb_keep(HB_WORKER *w, const uint32_t *key, double score){
+    size_t k = w->k;
+    int i = w->count;
+
+    if (i == w->cap && score <= w->scores[i - 1])
+        return;
+    for (int j = 0; j < w->count; j++) {
+        if (memcmp(w->keys + j * k, key, k * sizeof(uint32_t)) == 0)
+            return;
+    }
+    if (i == w->cap) {
+        i--;
+    } else {
+        w->count++;
+    }
+    for (; i > 0 && w->scores[i - 1] < score; i--) {
+        memcpy(w->keys + i * k, w->keys + (i - 1) * k, k * sizeof(uint32_t));
+        w->scores[i] = w->scores[i - 1];
+    }
+    memcpy(w->keys + i * k, key, k * sizeof(uint32_t));
+    w->scores[i] = score;
+}
+
+/* Every row of the key (n up to HILL_BREAK_EXHAUSTIVE): the letters of
+ * the rows (d, 0) are counted once, and the 26 rows (d, e) differ from it by
+ * a shift of those counts. The vectors d are dealt round-robin. */
+static void *hb_rank_worker(void *arg){
+    HB_WORKER *w = arg;
+    HB_SEARCH *s = w->s;
+    int n = s->n;
+    uint32_t total = 1, row[n + 1];
+
+    for (int k = 0; k < n; k++)
+        total *= HB_MOD;
+    for (uint32_t idx = w->id; idx < total; idx += s->nthreads) {
+        uint32_t hist[HB_MOD];
+
+        for (int k = 0, v = idx; k < n; k++, v /= HB_MOD)
+            row[k] = v % HB_MOD;
+        if (!hb_row_ok(row, n))
+            continue;
+        hb_row_hist(s, row, hist);
+        for (row[n] = 0; row[n] < HB_MOD; row[n]++)
+            hb_keep(w, row, hb_shift_score(s, hist, row[n]));
+    }
+    return NULL;
+}
+
+/* Larger keys, rows mod 13: the vectors d past the first entry are dealt
+ * round-robin, and the first entry is stepped through 0..12 adding one
+ * column of the letters each time. The 13 shifts e share the counts. */
+static void *hb_rank13_worker(void *arg){
+    HB_WORKER *w = arg;
+    HB_SEARCH *s = w->s;
+    int n = s->n;
+    size_t blocks = s->rblocks;
+    unsigned char *x = malloc(blocks);
+    uint32_t total = 1, row[n + 1];
+
+    for (int k = 1; k < n; k++)
+        total *= HB_MOD13;
+    for (uint32_t idx = w->id; x && idx < total; idx += s->nthreads) {
+        int zero = 1;
+        for (int k = 1, v = idx; k < n; k++, v /= HB_MOD13) {
+            row[k] = v % HB_MOD13;
+            zero &= (row[k] == 0);
+        }
+        for (size_t j = 0; j < blocks; j++) {
+            const unsigned char *y = s->ry13 + j * n;
+            uint32_t acc = 0;
+            for (int k = 1; k < n; k++)
+                acc += row[k] * y[k];
+            x[j] = acc % HB_MOD13;
+        }
+        for (row[0] = 0; row[0] < HB_MOD13; row[0]++) {
+            uint32_t hist[HB_MOD13] = { 0 };
+            for (size_t j = 0; j < blocks; j++) {
+                unsigned int next = x[j] + s->ry13[j * n];
+                hist[x[j]]++;
+                x[j] = (next >= HB_MOD13) ? next - HB_MOD13 : next;
+            }
+            if (zero && row[0] == 0)
+                continue;
+            for (row[n] = 0; row[n] < HB_MOD13; row[n]++) {
+                double score = 0.0;
+                for (int r = 0; r < HB_MOD13; r++)
+                    score += hist[r] * s->ulog13[(r + row[n]) % HB_MOD13];
+                hb_keep(w, row, score);
+            }
+        }
+    }
+    free(x);
+    return NULL;
+}
+
+/* Larger keys, rows mod 26: each ranked row mod 13 with every nonzero row
+ * mod 2, scored by the unigram fit of its letters. Rows mod 13 are dealt
+ * round-robin. */
+static void *hb_lift_worker(void *arg){
+    HB_WORKER *w = arg;
+    HB_SEARCH *s = w->s;
+    int n = s->n;
+    uint32_t row[n + 1];
+
+    for (int t = w->id; t < s->nrows13; t += s->nthreads) {
+        const uint32_t *r13 = s->rows13 + (size_t)t * (n + 1);
+        for (uint32_t bits = 1; bits < (1u << n); bits++) {
+            uint32_t hist[HB_MOD];
+            for (int k = 0; k < n; k++)
+                row[k] = (r13[k] % 2 == ((bits >> k) & 1)) ? r13[k] : r13[k] + HB_MOD13;
+            memset(hist, 0, sizeof(hist));
+            for (size_t j = 0; j < s->rblocks; j++) {
+                const unsigned char *y = s->ry + j * n;
+                uint32_t acc = 0;
+                for (int k = 0; k < n; k++)
+                    acc += row[k] * y[k];
+                hist[acc % HB_MOD]++;
+            }
+            for (uint32_t e2 = 0; e2 < 2; e2++) {
+                row[n] = (r13[n] % 2 == e2) ? r13[n] : r13[n] + HB_MOD13;
+                hb_keep(w, row, hb_shift_score(s, hist, row[n]));
+            }
+        }
+    }
+    return NULL;
+}
+
+/* Builds the key whose row i is ranked row pick[i] */
+static void hb_assemble(const HB_SEARCH *s, const int *pick, uint32_t *key){
+    int n = s->n;
+
+    for (int i = 0; i < n; i++) {
+        const uint32_t *row = s->rows + (size_t)pick[i] * (n + 1);
+        memcpy(key + (size_t)i * n, row, n * sizeof(uint32_t));
+        key[(size_t)n * n + i] = row[n];
+    }
+}
+
+/* 2x2 keys: every invertible pair of ranked rows, first rows dealt
+ * round-robin */
+static void *hb_pair_worker(void *arg){
+    HB_WORKER *w = arg;
+    HB_SEARCH *s = w->s;
+    char *buf = malloc(s->length + 1);
+    uint32_t key[6];
+    int pick[2];
+
+    for (pick[0] = w->id; buf && pick[0] < s->nrows; pick[0] += s->nthreads) {
+        for (pick[1] = 0; pick[1] < s->nrows; pick[1]++) {
+            hb_assemble(s, pick, key);
+            if (hb_unit(key, 2))
+                hb_keep(w, key, hb_score(s, key, buf));
+        }
+    }
+    free(buf);
+    return NULL;
+}
+
+/* Larger keys: hill climbing over which ranked row goes in each position,
+ * from random invertible choices, scored by the fitness of the sample.
+ * Restart r is seeded with r, so the results do not depend on the number
+ * of threads. */
+static void *hb_combine_worker(void *arg){
+    HB_WORKER *w = arg;
+    HB_SEARCH *s = w->s;
+    int n = s->n;
+    char *buf = malloc(s->length + 1);
+    uint32_t *key = malloc(w->k * sizeof(uint32_t));
+    int pick[n];
+
+    for (int r = w->id; buf && key && r < s->restarts; r += s->nthreads) {
+        unsigned int seed = (unsigned int)r + 1;
+        int improved = 1, tries = 0;
+        double score;
+
+        do {
+            for (int i = 0; i < n; i++)
+                pick[i] = rand_r(&seed) % s->nrows;
+            hb_assemble(s, pick, key);
+        } while (!hb_unit(key, n) && ++tries < 1000);
+        if (tries == 1000)
+            continue;
+        score = hb_score(s, key, buf);
+
+        for (int sweep = 0; improved && sweep < HB_SWEEPS; sweep++) {
+            improved = 0;
+            for (int i = 0; i < n; i++) {
+                int orig = pick[i], best = orig;
+                for (int v = 0; v < s->nrows; v++) {
+                    pick[i] = v;
+                    hb_assemble(s, pick, key);
+                    if (v == orig || !hb_unit(key, n))
+                        continue;
+                    double t = hb_score(s, key, buf);
+                    if (t > score) {
+                        score = t;
+                        best = v;
+                    }
+                }
+                pick[i] = best;
+                improved |= (best != orig);
+            }
+            /* Rows in the wrong order are only undone by swapping them */
+            for (int i = 0; i < n; i++) {
+                for (int j = i + 1; j < n; j++) {
+                    int tmp = pick[i];
+                    pick[i] = pick[j];
+                    pick[j] = tmp;
+                    hb_assemble(s, pick, key);
+                    double t = hb_score(s, key, buf);
+                    if (t > score) {
+                        score = t;
+                        improved = 1;
+                    } else {
+                        pick[j] = pick[i];
+                        pick[i] = tmp;
+                    }
+                }
+            }
+        }
+        hb_assemble(s, pick, key);
+        hb_keep(w, key, score);
+    }
+    free(buf);
+    free(key);
+    return NULL;
+}
+
+/* Runs fn on nthreads workers listing cap keys of k entries each, and
+ * merges their lists into out (cap keys too). Returns -1 if out of memory. */
+static int hb_run(HB_SEARCH *s, void *(*fn)(void *), size_t k, int cap, HB_WORKER *out){
+    int nthreads = s->nthreads;
+    pthread_t *threads = malloc(nthreads * sizeof(pthread_t));
+    HB_WORKER *workers = calloc(nthreads, sizeof(HB_WORKER));
+    int *started = calloc(nthreads, sizeof(int));
+    int status = (threads && workers && started) ? 0 : -1;
+
+    for (int t = 0; status == 0 && t < nthreads; t++) {
+        workers[t] = (HB_WORKER){ s, t, k, cap, malloc(cap * k * sizeof(uint32_t)), malloc(cap * sizeof(double)), 0 };
+        if (!workers[t].keys || !workers[t].scores)
+            status = -1;
+    }
+    if (status == 0) {
+        run_workers(fn, workers, sizeof(HB_WORKER), nthreads, threads, started);
+        for (int t = 0; t < nthreads; t++) {
+            for (int i = 0; i < workers[t].count; i++)
+                hb_keep(out, workers[t].keys + i * k, workers[t].scores[i]);
+        }
+    }
+    for (int t = 0; workers && t < nthreads; t++) {
+        free(workers[t].keys);
+        free(workers[t].scores);
+    }
+    free(threads);
+    free(workers);
+    free(started);
+    return status;
+}
+
+int hill_break(const char *cipher, size_t length, int n, const LANG_MODEL *model, int nthreads, int restarts, uint32_t *keys, double *scores, int ncand){
+    HB_SEARCH s;
+    size_t k = (size_t)n * n + n;
+    uint32_t *rows = malloc((size_t)HILL_BREAK_ROWS * (n + 1) * sizeof(uint32_t));
+    double *row_scores = malloc(HILL_BREAK_ROWS * sizeof(double));
+    uint32_t *found = malloc(ncand * k * sizeof(uint32_t));
+    uint32_t *rows13 = NULL;
+    double *scores13 = NULL;
+    unsigned char *y = NULL, *y13 = NULL;
+    size_t ylength;
+    HB_WORKER ranked = { &s, 0, (size_t)n + 1, HILL_BREAK_ROWS, rows, row_scores, 0 };
+    HB_WORKER best = { &s, 0, k, ncand, found, scores, 0 };
+    int status = -1;
+
+    if (n < 2 || n > HILL_BREAK_MAX || ncand < 1 || length / n == 0 || !model->quadgram_log || !rows || !row_scores || !found)
+        goto done;
+
+    s.length = length / n * n;
+    if (s.length > HILL_BREAK_SAMPLE)
+        s.length = HILL_BREAK_SAMPLE / n * n;
+    s.sample = cipher;
+    s.n = n;
+    s.model = model;
+    s.nthreads = (nthreads < 1) ? 1 : nthreads;
+    s.restarts = restarts;
+    s.failed = 0;
+    for (int x = 0; x < HB_MOD; x++) {
+        s.ulog[x] = model->unigram_log ? model->unigram_log[x]
+                    : (model->unigram[x] > 0.0 ? log10(model->unigram[x]) : model->floor_log);
+    }
+    for (int r = 0; r < HB_MOD13; r++) {
+        double p = model->unigram[r] + model->unigram[r + HB_MOD13];
+        s.ulog13[r] = (p > 0.0) ? log10(p) : model->floor_log;
+    }
+    ylength = s.length;
+    if (n > HILL_BREAK_EXHAUSTIVE) {
+        ylength = length / n * n;
+        if (ylength > HILL_BREAK_ROW_SAMPLE)
+            ylength = HILL_BREAK_ROW_SAMPLE / n * n;
+    }
+    y = malloc(ylength);
+    if (y == NULL)
+        goto done;
+    for (size_t j = 0; j < ylength; j++)
+        y[j] = cipher[j] - 'A';
+    s.y = y;
+
+    if (n <= HILL_BREAK_EXHAUSTIVE) {
+        if (hb_run(&s, hb_rank_worker, (size_t)n + 1, HILL_BREAK_ROWS, &ranked) != 0)
+            goto done;
+    } else {
+        HB_WORKER ranked13;
+
+        rows13 = malloc((size_t)HB_ROWS13 * (n + 1) * sizeof(uint32_t));
+        scores13 = malloc(HB_ROWS13 * sizeof(double));
+        y13 = malloc(ylength);
+        if (!rows13 || !scores13 || !y13)
+            goto done;
+        for (size_t j = 0; j < ylength; j++)
+            y13[j] = y[j] % HB_MOD13;
+        s.ry = y;
+        s.ry13 = y13;
+        s.rblocks = ylength / n;
+        ranked13 = (HB_WORKER){ &s, 0, (size_t)n + 1, HB_ROWS13, rows13, scores13, 0 };
+        if (hb_run(&s, hb_rank13_worker, (size_t)n + 1, HB_ROWS13, &ranked13) != 0)
+            goto done;
+        s.rows13 = rows13;
+        s.nrows13 = ranked13.count;
+        if (hb_run(&s, hb_lift_worker, (size_t)n + 1, HILL_BREAK_ROWS, &ranked) != 0)
+            goto done;
+    }
+    s.rows = rows;
+    s.nrows = ranked.count;
+    if (s.nrows == 0 || hb_run(&s, (n == 2) ? hb_pair_worker : hb_combine_worker, k, ncand, &best) != 0 || s.failed)
+        goto done;
+
+    /* Back to the enciphering key: A = D^-1, b = -A e */
+    for (int i = 0; i < best.count; i++) {
+        uint32_t *d = found + i * k, *a = keys + i * k;
+        if (hill_inverse_mod(d, a, n, HB_MOD) != 0)
+            goto done;
+        for (int r = 0; r < n; r++) {
+            uint32_t acc = 0;
+            for (int c = 0; c < n; c++)
+                acc = (acc + a[r * n + c] * d[(size_t)n * n + c]) % HB_MOD;
+            a[(size_t)n * n + r] = (HB_MOD - acc) % HB_MOD;
+        }
+    }
+    status = best.count;
+
+done:
+    free(rows);
+    free(row_scores);
+    free(found);
+    free(rows13);
+    free(scores13);
+    free(y);
+    free(y13);
+    return status;
+}
@@ -0,0 +1,74 @@
+#ifndef HILL_H
+#define HILL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "langmodel.h"
+
+/* Native linear algebra mod m for the Hill cipher. Matrices are n x n,
+ * row-major, with entries already reduced mod m; m is below 2^31 so every
+ * product fits in 64 bits. Composite moduli are handled by gcd row
+ * reduction, which never divides by a non-unit. */
+
+/* Moduli below this use the native routines */
+#define HILL_MAX_MOD (1u << 31)
+
+/* Determinant of a mod m */
+uint32_t hill_det_mod(const uint32_t *a, int n, uint32_t m);
+
+/* Inverse of a mod m into inv. Returns 0, or -1 if the determinant is not
+ * a unit mod m (inv is then left zero) or memory runs out. */
+int hill_inverse_mod(const uint32_t *a, uint32_t *inv, int n, uint32_t m);
+
+/* Affine Hill map y = A x + b mod m on consecutive n-byte blocks of input:
+ * letters count as 0..25, any other byte as 0 and is copied through, and a
+ * short last block is padded with zeros. Blocks are packed HILL_TILE at a
+ * time as the columns of a matrix, so the key is applied by a vectorized
+ * matrix-matrix multiply with the reduction mod m deferred to the end of
+ * each sum. Writes length bytes and a '\0' and returns 0, or returns -1
+ * without writing if memory runs out. */
+int hill_affine_AZ(const char *input, char *output, size_t length, const uint32_t *a, const uint32_t *b, int n, uint32_t m);
+
+/* Known-plaintext attack: finds a key (A then b, n*n + n entries) with
+ * cipher = A plain + b mod m on every whole block of the two aligned A–Z
+ * texts. Blocks are taken n+1 at a time (every start and stride) until
+ * they give an invertible system; the solution is checked over the whole
+ * text. The subsets are shared out among nthreads threads. Returns 0 and
+ * the index of the subset that gave the key in trial (if not NULL), or -1
+ * if no subset works. */
+int hill_known_plaintext(const char *plain, const char *cipher, size_t length, int n, uint32_t m, int nthreads, uint32_t *key, uint64_t *trial);
+
+/* Letters of the ciphertext deciphered to score a key of hill_break */
+#define HILL_BREAK_SAMPLE 1000
+/* Rows of the key kept by hill_break to be combined */
+#define HILL_BREAK_ROWS 200
+/* Largest n for which hill_break scores every key row, 26^(n+1) of them */
+#define HILL_BREAK_EXHAUSTIVE 4
+/* Largest n hill_break takes: past HILL_BREAK_EXHAUSTIVE the rows are
+ * scored mod 13, 13^(n+1) of them, which is what bounds it */
+#define HILL_BREAK_MAX 6
+/* Letters the rows are scored on past HILL_BREAK_EXHAUSTIVE */
+#define HILL_BREAK_ROW_SAMPLE 5000
+
+/* Ciphertext-only attack on the affine Hill cipher mod 26, for n from 2 to
+ * HILL_BREAK_MAX: ranks keys by the quadgram score under model (which must
+ * have quadgrams) of the first HILL_BREAK_SAMPLE letters of the A–Z
+ * ciphertext deciphered with them. Every row of the deciphering key is
+ * first scored alone by the unigram fit of the letters it gives; past
+ * HILL_BREAK_EXHAUSTIVE, rows are scored mod 13 on the first
+ * HILL_BREAK_ROW_SAMPLE letters and the best ones lifted to mod 26. The
+ * best HILL_BREAK_ROWS rows are combined: into every invertible key for
+ * n = 2, by restarts hill climbs over which row goes where otherwise.
+ * There is no pure hill climb over the key entries for n past
+ * HILL_BREAK_MAX: a wrong row gives letters about as uniform as any other
+ * and the climb has nothing to follow. The work is shared out among
+ * nthreads threads. Writes up to ncand keys (A then b, n*n + n entries
+ * each) best first into keys and their scores into scores, and returns how
+ * many, or -1 for an unsupported n, a model without quadgrams, or no
+ * memory. */
+int hill_break(const char *cipher, size_t length, int n, const LANG_MODEL *model, int nthreads, int restarts, uint32_t *keys, double *scores, int ncand);
+
+/* Inverse of x mod m, 0 if there is none */
+uint32_t hill_inv_u32(uint32_t x, uint32_t m);
+
+#endif
@@ -6,19 +6,82 @@
 #include <bits/getopt_core.h>
 #include "utils.h"
 
-#define MAX_TEXT 10000000
-#define MAX_NGRAM 10
 #define MAX_DIV 400
-#define MAX_GCD 1000
+#define MAX_RANKED 20
+
+/* Earliest position whose n-gram recurs with distances of gcd > 1 */
+typedef struct {
+    uint32_t *positions;   /* occurrences from that position on */
+    size_t count;
+    size_t len;
+    int gcd;
+    int found;
+} FIRST_HIT;
+
+/* An n-gram's candidates are its occurrences p_k followed by at least one
+ * more: the original scan took occurrences p_k, p_k+1, ... and the gcd of
+ * their consecutive distances, so only the suffix gcds matter. */
+static void first_hit(const uint32_t *pos, size_t count, size_t len, void *arg) {
+    FIRST_HIT *hit = arg;
+    size_t best_k = count;
+    int best_g = 0;
+    int g = 0;
+
+    /* Suffix gcds can only shrink towards the front, stop at 1 */
+    for (size_t k = count - 1; k-- > 0;) {
+        int dist = (int)(pos[k + 1] - pos[k]);
+        g = (g == 0) ? dist : gcd_aux(g, dist);
+        if (g <= 1)
+            break;
+        best_k = k;
+        best_g = g;
+    }
+
+    if (best_k < count && (!hit->found || pos[best_k] < hit->positions[0])) {
+        hit->count = count - best_k;
+        memcpy(hit->positions, pos + best_k, hit->count * sizeof(uint32_t));
+        hit->len = len;
+        hit->gcd = best_g;
+        hit->found = 1;
+    }
+}
+
+/* Every repeat of length >= n with its occurrences and distances */
+typedef struct {
+    const char *text;
+    FILE *out;
+    size_t repeats;
+} ALL_REPEATS;
+
+static void list_repeat(const uint32_t *pos, size_t count, size_t len, void *arg) {
+    ALL_REPEATS *all = arg;
+    int g = 0;
+
+    fprintf(all->out, "Repeat: %.*s (length %zu)\n", (int)len, all->text + pos[0], len);
+    fprintf(all->out, "Occurrences (%zu):", count);
+    for (size_t k = 0; k < count; k++) {
+        fprintf(all->out, " %u", pos[k]);
+    }
+    fprintf(all->out, "\nDistances:");
+    for (size_t k = 1; k < count; k++) {
+        int dist = (int)(pos[k] - pos[k - 1]);
+        g = (k == 1) ? dist : gcd_aux(g, dist);
+        fprintf(all->out, " %d", dist);
+    }
+    fprintf(all->out, "\nGCD of distances = %d\n\n", g);
+    all->repeats++;
+}
 
 int main(int argc, char *argv[]) {
     int opt;
     int ngram = 3;              
+    int list_all = 0;
+    int factors = 0;
     char *input_filename = NULL; 
     char *output_filename = NULL;
     FILE *output_file;
 
-    while ((opt = getopt(argc, argv, "n:i:o:")) != -1) {
+    while ((opt = getopt(argc, argv, "n:i:o:aH")) != -1) {
         switch (opt) {
             case 'n':
                 ngram = atoi(optarg);
@@ -29,8 +92,14 @@ int main(int argc, char *argv[]) {
             case 'o':
                 output_filename = optarg;
                 break;
+            case 'a':
+                list_all = 1;
+                break;
+            case 'H':
+                factors = 1;
+                break;
             default:
-                fprintf(stderr, "Usage: %s [-n ngram_length] [-i infile] [-o outfile]\n", argv[0]);
+                fprintf(stderr, "Usage: %s [-n ngram_length] [-a | -H] [-i infile] [-o outfile]\n", argv[0]);
                 return EXIT_FAILURE;
         }
     }
@@ -41,66 +110,14 @@ int main(int argc, char *argv[]) {
     }
 
 
-    /*Open the input file for reading*/
-    char *buffer = NULL;
+    /*Read and normalize the input to A-Z*/
     size_t bytes_read = 0;
-
-    if (input_filename == NULL) {
-        /* Leer desde stdin */
-        size_t capacity = 1024;
-        buffer = malloc(capacity);
-        if (!buffer) {
-            perror("malloc");
-            return EXIT_FAILURE;
-        }
-    
-        int c;
-        while ((c = fgetc(stdin)) != EOF) {
-            if (bytes_read + 1 >= capacity) {
-                capacity *= 2;
-                buffer = realloc(buffer, capacity);
-                if (!buffer) {
-                    perror("realloc");
-                    return EXIT_FAILURE;
-                }
-            }
-            buffer[bytes_read++] = (char)c;
-        }
-        buffer[bytes_read] = '\0';
-    } else {
-        /* Leer desde archivo */
-        FILE *input_file = fopen(input_filename, "rb");
-        if (input_file == NULL) {
-            perror("Error opening input file");
-            return EXIT_FAILURE;
-        }
-
-        fseek(input_file, 0, SEEK_END);
-        bytes_read = ftell(input_file);
-        rewind(input_file);
-
-        buffer = malloc(bytes_read + 1);
-        if (!buffer) {
-            perror("malloc");
-            fclose(input_file);
-            return EXIT_FAILURE;
-        }
-
-        if (fread(buffer, 1, bytes_read, input_file) != bytes_read) {
-            perror("Error reading file");
-            fclose(input_file);
-            free(buffer);
-            return EXIT_FAILURE;
-        }
-        buffer[bytes_read] = '\0';
-        
-        fclose(input_file);
+    char *text = read_text_AZ(input_filename, &bytes_read);
+    if (text == NULL) {
+        perror("Error reading input");
+        return EXIT_FAILURE;
     }
 
-    char *text = malloc(bytes_read + 1);
-    int purged = normalize_AZ(buffer, bytes_read, text);
-    bytes_read = bytes_read - purged;
-
     /* Open output file */
     if (output_filename == NULL) {
         output_file = stdout;
@@ -115,66 +132,85 @@ int main(int argc, char *argv[]) {
     fprintf(output_file, "====== KASISKI TEST =====\n");
     fprintf(output_file, "n-gram length: %d\n\n", ngram);
 
+    size_t len = strlen(text);
 
-    int *distances = malloc(MAX_TEXT * sizeof(int));
-    int len = strlen(text);
+    /* Rank key lengths by how many repeat distances they divide */
+    if (factors) {
+        KASISKI_DISTANCES d;
+        KASISKI_FACTOR ranked[MAX_DIV - 1];
+        int nranked;
 
+        if (kasiski_distances(text, len, ngram, &d) != 0
+                || (nranked = kasiski_factors(&d, MAX_DIV, ranked)) < 0) {
+            perror("malloc");
+            return EXIT_FAILURE;
+        }
 
-    int flag = 0;
+        if (d.total == 0) {
+            fprintf(output_file, "No repeated n-grams found for any tested size (>=2 and <= %d).\n", ngram);
+        } else {
+            fprintf(output_file, "Distances between repeated n-grams: %zu (%zu distinct)\n\n", d.total, d.size);
+            fprintf(output_file, "Key length ranking (distances divided):\n");
+            for (int k = 0; k < nranked && k < MAX_RANKED && ranked[k].hits > 0; k++) {
+                fprintf(output_file, "%2d. n = %d: %zu (%.1f%%)\n", k + 1, ranked[k].length,
+                        ranked[k].hits, 100.0 * ranked[k].hits / d.total);
+            }
+        }
 
-    for (size_t i = 0; i + ngram <= len && !flag; i++) {
-        /* Take n-gram starting at position i */
-        char temp[MAX_NGRAM + 1];
-        strncpy(temp, text + i, ngram);
-        temp[ngram] = '\0';
+        kasiski_distances_free(&d);
+        fclose(output_file);
+        free(text);
+        return EXIT_SUCCESS;
+    }
 
-        /* Search for further occurrences */
-        size_t positions[2000];
-        int count = 0;
+    int flag = 0;
 
-        /* Save first occurrence */
-        positions[count++] = i;
+    if (list_all) {
+        /* Repeats of every length are the lcp-intervals of the suffix array */
+        ALL_REPEATS all = { text, output_file, 0 };
+        uint32_t *sa = suffix_array(text, len);
+        uint32_t *lcp = sa ? lcp_array(text, len, sa) : NULL;
 
-        /* Look for further occurrences */
-        for (size_t j = i + 1; j + ngram <= len; j++) {
-            if (strncmp(temp, text + j, ngram) == 0) {
-                positions[count++] = j;
-            }
+        if (!lcp || suffix_repeats(sa, lcp, len, ngram, list_repeat, &all) != 0) {
+            perror("malloc");
+            return EXIT_FAILURE;
         }
+        free(sa);
+        free(lcp);
+        flag = (all.repeats > 0);
+    } else {
+        /* Fixed length repeats straight from the n-gram index */
+        FIRST_HIT hit = { NULL, 0, 0, 0, 0 };
+        NGRAM_INDEX idx;
 
-        if (count >= 2) {
-            /* Calculate distances and their GCD */
-            int g = 0;
-            for (int k = 1; k < count; k++) {
-                int dist = (int)(positions[k] - positions[k - 1]);
-                if (k == 1) g = dist;
-                else g = gcd_aux(g, dist);
-            }
-
-            if (g > 1) {
-                /* Output results */
-                fprintf(output_file, "N-gram: %s\n", temp);
-                fprintf(output_file, "Occurrences (%d):", count);
-                for (int k = 0; k < count; k++) {
-                    fprintf(output_file, " %zu", positions[k]);
-                }
-                fprintf(output_file, "\n");
-                fprintf(output_file, "GCD of distances = %d -> possible key length\n\n", g);
-                flag = 1;
-                break;
+        if (ngram_index_build(&idx, text, len, ngram, 2) != 0
+                || !(hit.positions = malloc((len + 1) * sizeof(uint32_t)))) {
+            perror("malloc");
+            return EXIT_FAILURE;
+        }
+        ngram_index_foreach(&idx, first_hit, &hit);
+        ngram_index_free(&idx);
+
+        if (hit.found) {
+            /* Output results */
+            fprintf(output_file, "N-gram: %.*s\n", (int)hit.len, text + hit.positions[0]);
+            fprintf(output_file, "Occurrences (%zu):", hit.count);
+            for (size_t k = 0; k < hit.count; k++) {
+                fprintf(output_file, " %u", hit.positions[k]);
             }
+            fprintf(output_file, "\n");
+            fprintf(output_file, "GCD of distances = %d -> possible key length\n\n", hit.gcd);
+            flag = 1;
         }
+        free(hit.positions);
     }
-    
 
     if (!flag) {
         fprintf(output_file, "No repeated n-grams found for any tested size (>=2 and <= %d).\n", ngram);
     }
 
     fclose(output_file);
-    free(buffer);
     free(text);
-    free(distances);
     
 
     return EXIT_SUCCESS;
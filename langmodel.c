@@ -0,0 +1,224 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "langmodel.h"
+
+static const double P_english[26] = {
+    0.0804, 0.0154, 0.0306, 0.0399, 0.1251, 0.0230, 0.0196, 0.0549,
+    0.0726, 0.0016, 0.0067, 0.0414, 0.0253, 0.0709, 0.0760, 0.0200,
+    0.0011, 0.0612, 0.0654, 0.0925, 0.0271, 0.0099, 0.0192, 0.0019,
+    0.0173, 0.0019
+};
+
+static const double P_spanish[26] = {
+    0.1196, 0.0092, 0.0292, 0.0687, 0.1678, 0.0052, 0.0073, 0.0089,
+    0.0415, 0.0030, 0.0000, 0.0837, 0.0212, 0.0701, 0.0869, 0.0277,
+    0.0153, 0.0494, 0.0788, 0.0331, 0.0480, 0.0039, 0.0000, 0.0006,
+    0.0154, 0.0015
+};
+
+static const LANG_MODEL builtin[2] = {
+    { "English", IC_ENGLISH, -6.0, P_english, NULL, NULL, NULL, NULL, 0 },
+    { "Spanish", IC_SPANISH, -6.0, P_spanish, NULL, NULL, NULL, NULL, 0 },
+};
+
+const LANG_MODEL *lang_model_builtin(int language){
+    return &builtin[language == 1 ? 1 : 0];
+}
+
+/* True if bytes at off are 8-byte aligned, after the header and inside the file */
+static int section_ok(const LANG_MODEL_HEADER *h, size_t size, uint64_t off, size_t bytes){
+    return off % 8 == 0 && off >= h->header_size && off <= size && bytes <= size - off;
+}
+
+int lang_model_load(LANG_MODEL *m, const char *path){
+    struct stat st;
+    const LANG_MODEL_HEADER *h;
+    const char *base;
+    int fd = open(path, O_RDONLY);
+
+    memset(m, 0, sizeof(*m));
+    if (fd < 0)
+        return -1;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    if ((size_t)st.st_size < sizeof(LANG_MODEL_HEADER)) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+
+    m->map_size = st.st_size;
+    m->map = mmap(NULL, m->map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (m->map == MAP_FAILED) {
+        m->map = NULL;
+        return -1;
+    }
+
+    base = m->map;
+    h = m->map;
+    if (memcmp(h->magic, LANG_MODEL_MAGIC, sizeof(LANG_MODEL_MAGIC)) != 0
+            || h->version != LANG_MODEL_VERSION
+            || h->header_size < sizeof(LANG_MODEL_HEADER)
+            || memchr(h->name, '\0', sizeof(h->name)) == NULL
+            || !section_ok(h, m->map_size, h->unigram_off, 26 * sizeof(double))
+            || !section_ok(h, m->map_size, h->unigram_log_off, 26 * sizeof(float))
+            || !section_ok(h, m->map_size, h->bigram_log_off, LANG_BIGRAMS * sizeof(float))
+            || !section_ok(h, m->map_size, h->quadgram_log_off, LANG_QUADGRAMS * sizeof(float))) {
+        lang_model_close(m);
+        errno = EINVAL;
+        return -1;
+    }
+
+    m->name = h->name;
+    m->ic = h->ic;
+    m->floor_log = h->floor_log;
+    m->unigram = (const double *)(base + h->unigram_off);
+    m->unigram_log = (const float *)(base + h->unigram_log_off);
+    m->bigram_log = (const float *)(base + h->bigram_log_off);
+    m->quadgram_log = (const float *)(base + h->quadgram_log_off);
+    return 0;
+}
+
+void lang_model_close(LANG_MODEL *m){
+    if (m->map)
+        munmap(m->map, m->map_size);
+    memset(m, 0, sizeof(*m));
+}
+
+/* Quadgram code of the four letters at p */
+static inline unsigned quad_code(const unsigned char *p){
+    return (((p[0] - 'A') * 26u + (p[1] - 'A')) * 26u + (p[2] - 'A')) * 26u + (p[3] - 'A');
+}
+
+double lang_quadgram_score(const float *quadgram_log, const char *text, size_t length){
+    const unsigned char *p = (const unsigned char *)text;
+    double acc0 = 0.0, acc1 = 0.0, acc2 = 0.0, acc3 = 0.0;
+    size_t i = 0;
+
+    if (length < 4)
+        return 0.0;
+
+    /* The code of each window is rebuilt from its four letters rather than
+     * rolled from the previous one, so the four lanes carry no dependency
+     * and the table loads overlap */
+    for (; i + 7 < length; i += 4) {
+        acc0 += quadgram_log[quad_code(p + i)];
+        acc1 += quadgram_log[quad_code(p + i + 1)];
+        acc2 += quadgram_log[quad_code(p + i + 2)];
+        acc3 += quadgram_log[quad_code(p + i + 3)];
+    }
+    for (; i + 3 < length; i++)
+        acc0 += quadgram_log[quad_code(p + i)];
+
+    return (acc0 + acc1) + (acc2 + acc3);
+}
+
+double lang_fitness(const LANG_MODEL *m, const char *text, size_t length){
+    uint64_t count[26] = {0};
+    double score = 0.0;
+
+    if (m->quadgram_log)
+        return lang_quadgram_score(m->quadgram_log, text, length);
+
+    /* Unigram fallback for the builtins: the likelihood only depends on the counts */
+    for (size_t i = 0; i < length; i++)
+        count[text[i] - 'A']++;
+    for (int j = 0; j < 26; j++) {
+        if (count[j])
+            score += count[j] * (m->unigram_log ? m->unigram_log[j]
+                     : (m->unigram[j] > 0.0 ? log10(m->unigram[j]) : m->floor_log));
+    }
+    return score;
+}
+
+/* log10 of count / total, floor_log when the n-gram was never seen */
+static float log_prob(uint64_t count, uint64_t total, double floor_log){
+    return count ? (float)log10((double)count / total) : (float)floor_log;
+}
+
+int lang_model_build(const char *text, size_t length, const char *name, const char *path){
+    LANG_MODEL_HEADER h;
+    uint64_t uni[26] = {0}, bi[LANG_BIGRAMS] = {0};
+    uint32_t *quad = calloc(LANG_QUADGRAMS, sizeof(uint32_t));
+    double unigram[26];
+    float unigram_log[26], *table;
+    uint64_t nbi = 0, nquad = 0;
+    double coincidences = 0.0;
+    unsigned code = 0;
+    FILE *out;
+    int ok;
+
+    table = malloc(LANG_QUADGRAMS * sizeof(float));
+    if (!quad || !table) {
+        free(quad);
+        free(table);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    /* One pass with a rolling base-26 code of the last four letters */
+    for (size_t i = 0; i < length; i++) {
+        unsigned c = (unsigned)(text[i] - 'A');
+        uni[c]++;
+        code = (code * 26 + c) % LANG_QUADGRAMS;
+        if (i >= 1) {
+            bi[code % LANG_BIGRAMS]++;
+            nbi++;
+        }
+        if (i >= 3) {
+            quad[code]++;
+            nquad++;
+        }
+    }
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, LANG_MODEL_MAGIC, sizeof(LANG_MODEL_MAGIC));
+    h.version = LANG_MODEL_VERSION;
+    h.header_size = sizeof(h);
+    strncpy(h.name, name, sizeof(h.name) - 1);
+    h.letters = length;
+    /* Unseen n-grams: a hundredth of a single occurrence in the corpus */
+    h.floor_log = log10(0.01 / (length ? (double)length : 1.0));
+    for (int j = 0; j < 26; j++) {
+        unigram[j] = length ? (double)uni[j] / length : 0.0;
+        unigram_log[j] = log_prob(uni[j], length, h.floor_log);
+        coincidences += (double)uni[j] * (uni[j] ? uni[j] - 1 : 0);
+    }
+    h.ic = (length > 1) ? coincidences / ((double)length * (length - 1)) : 0.0;
+    h.unigram_off = sizeof(h);
+    h.unigram_log_off = h.unigram_off + sizeof(unigram);
+    h.bigram_log_off = h.unigram_log_off + 8 * ((sizeof(unigram_log) + 7) / 8);
+    h.quadgram_log_off = h.bigram_log_off + LANG_BIGRAMS * sizeof(float);
+
+    out = fopen(path, "wb");
+    if (!out) {
+        free(quad);
+        free(table);
+        return -1;
+    }
+    ok = fwrite(&h, sizeof(h), 1, out) == 1
+      && fwrite(unigram, sizeof(unigram), 1, out) == 1
+      && fwrite(unigram_log, sizeof(unigram_log), 1, out) == 1
+      && fseek(out, (long)h.bigram_log_off, SEEK_SET) == 0;
+    for (int k = 0; ok && k < LANG_BIGRAMS; k++)
+        table[k] = log_prob(bi[k], nbi, h.floor_log);
+    ok = ok && fwrite(table, sizeof(float), LANG_BIGRAMS, out) == LANG_BIGRAMS;
+    for (int k = 0; ok && k < LANG_QUADGRAMS; k++)
+        table[k] = log_prob(quad[k], nquad, h.floor_log);
+    ok = ok && fwrite(table, sizeof(float), LANG_QUADGRAMS, out) == LANG_QUADGRAMS;
+    ok = (fclose(out) == 0) && ok;
+
+    free(quad);
+    free(table);
+    return ok ? 0 : -1;
+}
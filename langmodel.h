@@ -0,0 +1,76 @@
+#ifndef LANGMODEL_H
+#define LANGMODEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Expected index of coincidence of random and natural text */
+#define IC_RANDOM 0.0385
+#define IC_ENGLISH 0.0650
+#define IC_SPANISH 0.0770
+
+#define LANG_MODEL_MAGIC "LANGMOD"
+#define LANG_MODEL_VERSION 1
+
+/* Number of entries of the n-gram tables */
+#define LANG_BIGRAMS (26 * 26)
+#define LANG_QUADGRAMS (26 * 26 * 26 * 26)
+
+/* Header of a model file. The tables follow at the given byte offsets,
+ * 8-byte aligned, in host byte order, so a mapped file is used in place:
+ *   unigram      26 doubles, probabilities
+ *   unigram_log  26 floats, log10 probabilities
+ *   bigram_log   26^2 floats, log10 P(pair), index a*26 + b
+ *   quadgram_log 26^4 floats, log10 P(quadgram), index ((a*26+b)*26+c)*26+d
+ * N-grams missing from the corpus get floor_log. */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    char name[32];
+    double ic;             /* IC of the corpus */
+    double floor_log;      /* log10 probability of an unseen n-gram */
+    uint64_t letters;      /* letters in the corpus */
+    uint64_t unigram_off;
+    uint64_t unigram_log_off;
+    uint64_t bigram_log_off;
+    uint64_t quadgram_log_off;
+} LANG_MODEL_HEADER;
+
+/* A language model, either builtin or mapped from a file. Tables a model
+ * does not have are NULL (the builtins only carry unigrams). */
+typedef struct {
+    const char *name;
+    double ic;
+    double floor_log;
+    const double *unigram;
+    const float *unigram_log;
+    const float *bigram_log;
+    const float *quadgram_log;
+    void *map;             /* mapping of the file, NULL for builtins */
+    size_t map_size;
+} LANG_MODEL;
+
+/* Builtin model of a language: 0 English, 1 Spanish */
+const LANG_MODEL *lang_model_builtin(int language);
+
+/* Maps a model file read-only and points the model at its tables, without
+ * copying them. Returns 0, or -1 with errno set (EINVAL for a bad file). */
+int lang_model_load(LANG_MODEL *m, const char *path);
+
+/* Unmaps a model returned by lang_model_load */
+void lang_model_close(LANG_MODEL *m);
+
+/* Log10 likelihood of an A–Z text under a quadgram table (quadgram_log of
+ * a loaded model): the sum over its length - 3 overlapping quadgrams. */
+double lang_quadgram_score(const float *quadgram_log, const char *text, size_t length);
+
+/* Fitness of an A–Z text under a model, higher is better: the quadgram
+ * score when the model has quadgrams, else the unigram log10 likelihood. */
+double lang_fitness(const LANG_MODEL *m, const char *text, size_t length);
+
+/* Counts the unigrams, bigrams and quadgrams of an A–Z corpus and writes a
+ * model file. Returns 0, or -1 with errno set. */
+int lang_model_build(const char *text, size_t length, const char *name, const char *path);
+
+#endif
@@ -1,5 +1,35 @@
+#include <stdlib.h>
+#include <string.h>
 #include "lfsr.h"
 
+/* Parity of every byte value */
+#define P2(n) n, n ^ 1, n ^ 1, n
+#define P4(n) P2(n), P2(n ^ 1), P2(n ^ 1), P2(n)
+#define P6(n) P4(n), P4(n ^ 1), P4(n ^ 1), P4(n)
+static const uint8_t parity_table[256] = { P6(0), P6(1), P6(1), P6(0) };
+
+static inline uint32_t parity32(uint32_t x){
+    x ^= x >> 16;
+    x ^= x >> 8;
+    return parity_table[x & 0xff];
+}
+
+/* Applies a linear map given as per-byte images to a state */
+static inline uint32_t table_apply(const uint32_t tab[4][256], uint32_t x){
+    return tab[0][x & 0xff] ^ tab[1][(x >> 8) & 0xff]
+         ^ tab[2][(x >> 16) & 0xff] ^ tab[3][x >> 24];
+}
+
+/* 32x32 matrix over GF(2) stored by columns: m[j] is the image of bit j */
+static inline uint32_t matrix_apply(const uint32_t m[32], uint32_t x){
+    uint32_t y = 0;
+    while (x) {
+        y ^= m[__builtin_ctz(x)];
+        x &= x - 1;
+    }
+    return y;
+}
+
 void lfsr_init(LFSR *l, uint32_t seed, uint32_t mask, int size){
     l->state = seed;
     l->mask = mask;
@@ -8,20 +38,236 @@ void lfsr_init(LFSR *l, uint32_t seed, uint32_t mask, int size){
 
 int lfsr_next_bit(LFSR *l){
     int output;
-    uint32_t x;
-    int feedback = 0;
+    uint32_t feedback;
 
     output = l->state & 1;
-    
-    x = l->state & l->mask;
 
-    while (x){
-        feedback ^= (x & 1);
-        x >>= 1;
-    }
+    feedback = parity32(l->state & l->mask);
 
-    l->state = (l->state >> 1) | (uint32_t)feedback << (l->size - 1);
+    l->state = (l->state >> 1) | feedback << (l->size - 1);
 
     return output;
 }
 
+void lfsr_table_init(LFSR_TABLE *t, uint32_t mask, int size){
+    uint32_t low = (size >= 32) ? 0xFFFFFFFFu : ((1u << size) - 1);
+
+    t->mask = mask;
+    t->size = size;
+    t->block_bits = (size >= 8) ? size : 0;
+
+    if (t->block_bits == 0)
+        return;
+
+    for (int k = 0; k < 4; k++) {
+        for (uint32_t v = 0; v < 256; v++) {
+            LFSR tmp;
+            int i;
+
+            /* Only bits below size are ever set when the tables are used */
+            lfsr_init(&tmp, (v << (8 * k)) & low, mask, size);
+            for (i = 0; i < 8; i++)
+                lfsr_next_bit(&tmp);
+            t->byte[k][v] = tmp.state;
+            for (; i < t->block_bits; i++)
+                lfsr_next_bit(&tmp);
+            t->block[k][v] = tmp.state;
+        }
+    }
+}
+
+uint64_t lfsr_next_bits(LFSR *l, const LFSR_TABLE *t, int nbits){
+    uint64_t out = 0;
+    int done = 0;
+
+    /* Seed bits above size-1 leave the register non-linearly, flush them serially */
+    while (done < nbits && l->size < 32 && (l->state >> l->size))
+        out |= (uint64_t)lfsr_next_bit(l) << done++;
+
+    if (t->block_bits) {
+        /* The first size outputs are the low bits of the current state */
+        uint32_t low = (t->block_bits == 32) ? 0xFFFFFFFFu : ((1u << t->block_bits) - 1);
+
+        while (nbits - done >= t->block_bits) {
+            out |= (uint64_t)(l->state & low) << done;
+            l->state = table_apply(t->block, l->state);
+            done += t->block_bits;
+        }
+        while (nbits - done >= 8) {
+            out |= (uint64_t)(l->state & 0xff) << done;
+            l->state = table_apply(t->byte, l->state);
+            done += 8;
+        }
+    }
+
+    while (done < nbits)
+        out |= (uint64_t)lfsr_next_bit(l) << done++;
+
+    return out;
+}
+
+void lfsr_jump(LFSR *l, uint64_t steps){
+    uint32_t power[32], square[32];
+    uint32_t x;
+    int j;
+
+    /* Seed bits above size-1 leave the register non-linearly, flush them serially */
+    while (steps > 0 && l->size < 32 && (l->state >> l->size)) {
+        lfsr_next_bit(l);
+        steps--;
+    }
+
+    /* Short jumps are cheaper step by step */
+    if (steps < 64) {
+        while (steps--)
+            lfsr_next_bit(l);
+        return;
+    }
+
+    /* Companion matrix: bit j moves to j-1, taps feed bit size-1 */
+    for (j = 0; j < 32; j++) {
+        if (j >= l->size) {
+            power[j] = 0;
+            continue;
+        }
+        power[j] = (j > 0) ? (1u << (j - 1)) : 0;
+        if ((l->mask >> j) & 1)
+            power[j] |= 1u << (l->size - 1);
+    }
+
+    /* Square and multiply, applying T^(2^i) straight to the state */
+    x = l->state;
+    while (steps) {
+        if (steps & 1)
+            x = matrix_apply(power, x);
+        steps >>= 1;
+        if (steps) {
+            for (j = 0; j < 32; j++)
+                square[j] = matrix_apply(power, power[j]);
+            for (j = 0; j < 32; j++)
+                power[j] = square[j];
+        }
+    }
+    l->state = x;
+}
+
+/* Loads 64 bits from an unaligned byte address */
+static inline uint64_t load64(const uint8_t *p){
+    uint64_t w;
+    memcpy(&w, p, sizeof(w));
+    return w;
+}
+
+/* Two words at a time, lowered to whatever vector unit the target has */
+typedef uint64_t v2u64 __attribute__((vector_size(16)));
+
+static inline v2u64 load2x64(const void *p){
+    v2u64 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void store2x64(void *p, v2u64 v){
+    memcpy(p, &v, sizeof(v));
+}
+
+size_t lfsr_linear_complexity(const uint8_t *bits, size_t nbits, uint32_t *profile){
+    size_t words = nbits / 64 + 2;
+    size_t rev_bytes = 8 * (2 * words + 2);
+    uint8_t *rev = calloc(8 * rev_bytes, 1);
+    uint64_t *c = calloc(words + 1, sizeof(uint64_t));
+    uint64_t *b = calloc(words + 1, sizeof(uint64_t));
+    uint64_t *t = calloc(words + 1, sizeof(uint64_t));
+    size_t L = 0, L_b = 0;             /* lengths of C and B, deg C <= L */
+    size_t m = 0;                      /* step of the last length change */
+    int started = 0;                   /* no length change yet, m undefined */
+
+    if (!rev || !c || !b || !t) {
+        free(rev);
+        free(c);
+        free(b);
+        free(t);
+        return 0;
+    }
+
+    /* The sequence is stored reversed (bit k = s[nbits-1-k]) so that the
+     * window s[n], s[n-1], ... lines up with the coefficients c0, c1, ...
+     * Copy r is shifted down by r bits, so any window is a byte-aligned load. */
+    for (size_t i = 0; i < nbits; i++) {
+        if ((bits[i / 8] >> (i % 8)) & 1) {
+            size_t k = nbits - 1 - i;
+            for (int r = 0; r < 8 && r <= (int)k; r++)
+                rev[r * rev_bytes + (k - r) / 8] |= 1 << ((k - r) % 8);
+        }
+    }
+    c[0] = 1;
+    b[0] = 1;
+
+    for (size_t n = 0; n < nbits; n++) {
+        size_t o = nbits - 1 - n;
+        const uint8_t *win = rev + (o % 8) * rev_bytes + o / 8;
+        size_t c_words = L / 64 + 1;
+        uint64_t acc = 0;
+        v2u64 vacc0 = {0, 0}, vacc1 = {0, 0};
+        size_t w = 0;
+
+        /* Discrepancy: parity of C AND the window starting at s[n] */
+        for (; w + 4 <= c_words; w += 4) {
+            vacc0 ^= load2x64(c + w) & load2x64(win + 8 * w);
+            vacc1 ^= load2x64(c + w + 2) & load2x64(win + 8 * w + 16);
+        }
+        for (; w < c_words; w++)
+            acc ^= c[w] & load64(win + 8 * w);
+        vacc0 ^= vacc1;
+        acc ^= vacc0[0] ^ vacc0[1];
+
+        if (__builtin_parityll(acc)) {
+            /* C(x) += x^(n-m) B(x); the first change uses B = 1, shift n+1 */
+            size_t shift = started ? n - m : n + 1;
+            size_t ws = shift / 64;
+            int bs = shift % 64;
+            size_t b_words = L_b / 64 + 1;
+            int grow = (2 * L <= n);
+
+            if (grow)
+                memcpy(t, c, c_words * sizeof(uint64_t));
+
+            if (bs == 0) {
+                for (size_t w = 0; w < b_words; w++)
+                    c[w + ws] ^= b[w];
+            } else {
+                size_t w = 1;
+
+                c[ws] ^= b[0] << bs;
+                for (; w + 2 <= b_words + 1; w += 2) {
+                    v2u64 hi = load2x64(b + w), lo = load2x64(b + w - 1);
+                    store2x64(c + w + ws, load2x64(c + w + ws) ^ (hi << bs) ^ (lo >> (64 - bs)));
+                }
+                for (; w <= b_words; w++)
+                    c[w + ws] ^= (b[w] << bs) | (b[w - 1] >> (64 - bs));
+            }
+
+            if (grow) {
+                uint64_t *swap = b;
+
+                /* B takes the old C; the spare buffer is kept all zero */
+                memset(swap, 0, (b_words + 1) * sizeof(uint64_t));
+                b = t;
+                t = swap;
+                L_b = L;
+                L = n + 1 - L;
+                m = n;
+                started = 1;
+            }
+        }
+
+        if (profile)
+            profile[n] = (uint32_t)L;
+    }
+
+    free(rev);
+    free(c);
+    free(b);
+    free(t);
+    return L;
+}
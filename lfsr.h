@@ -1,6 +1,7 @@
 #ifndef LFSR_H
 #define LFSR_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 /* Struct for LFSR */
@@ -10,8 +11,36 @@ typedef struct {
     int size;        /* size of the LFSR in bits */
 } LFSR;
 
+/* Precomputed transition tables for the word-at-a-time engine.
+ * The LFSR update is linear over GF(2), so the state after k steps is the
+ * XOR of the images of each state byte, looked up in block/byte tables. */
+typedef struct {
+    uint32_t block[4][256]; /* state after block_bits steps, per state byte */
+    uint32_t byte[4][256];  /* state after 8 steps, per state byte */
+    uint32_t mask;          /* taps the tables were built for */
+    int size;               /* size the tables were built for */
+    int block_bits;         /* steps per block lookup (0 if size < 8) */
+} LFSR_TABLE;
+
 void lfsr_init(LFSR *l, uint32_t seed, uint32_t mask, int size);
 
 int lfsr_next_bit(LFSR *l);
 
-#endif
\ No newline at end of file
+/* Builds the transition tables of an LFSR with the given taps and size */
+void lfsr_table_init(LFSR_TABLE *t, uint32_t mask, int size);
+
+/* Returns the next nbits (1..64) output bits, bit i being the i-th output.
+ * Bit-exact with nbits calls to lfsr_next_bit; t must match l's mask/size. */
+uint64_t lfsr_next_bits(LFSR *l, const LFSR_TABLE *t, int nbits);
+
+/* Advances the LFSR by steps in O(log steps) using powers of its companion
+ * matrix over GF(2). Equivalent to steps calls to lfsr_next_bit. */
+void lfsr_jump(LFSR *l, uint64_t steps);
+
+/* Linear complexity of the sequence of nbits bits stored LSB first in bytes
+ * (bit i is bit i%8 of bits[i/8]), by Berlekamp-Massey over GF(2) with the
+ * polynomials packed 64 coefficients per word. If profile is not NULL,
+ * profile[i] receives the linear complexity of the first i+1 bits. */
+size_t lfsr_linear_complexity(const uint8_t *bits, size_t nbits, uint32_t *profile);
+
+#endif
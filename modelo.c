@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <bits/getopt_core.h>
+#include "utils.h"
+
+int main(int argc, char *argv[]) {
+    int opt;
+    char *input_filename = NULL;
+    char *output_filename = NULL;
+    char *name = "corpus";
+    LANG_MODEL model;
+
+    /* Parse command line arguments */
+    while ((opt = getopt(argc, argv, "i:o:N:")) != -1) {
+        switch (opt) {
+            case 'i':
+                input_filename = optarg;
+                break;
+            case 'o':
+                output_filename = optarg;
+                break;
+            case 'N':
+                name = optarg;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s -o modelfile [-N name] [-i corpus]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (output_filename == NULL) {
+        fprintf(stderr, "Error: Missing output model file.\n");
+        fprintf(stderr, "Usage: %s -o modelfile [-N name] [-i corpus]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    /*Read and normalize the corpus to A-Z*/
+    size_t letters = 0;
+    char *buffer = read_text_AZ(input_filename, &letters);
+    if (buffer == NULL) {
+        perror("Error reading corpus");
+        return EXIT_FAILURE;
+    }
+
+    if (lang_model_build(buffer, letters, name, output_filename) != 0) {
+        perror("Error writing model file");
+        free(buffer);
+        return EXIT_FAILURE;
+    }
+    free(buffer);
+
+    /* Read it back the way the tools will */
+    if (lang_model_load(&model, output_filename) != 0) {
+        perror("Error loading model file");
+        return EXIT_FAILURE;
+    }
+
+    printf("====== LANGUAGE MODEL =====\n");
+    printf("Name: %s\n", model.name);
+    printf("Corpus letters: %zu\n", letters);
+    printf("IC: %f\n", model.ic);
+    printf("Most frequent letter: ");
+    {
+        int best = 0;
+        for (int j = 1; j < 26; j++) {
+            if (model.unigram[j] > model.unigram[best]) {
+                best = j;
+            }
+        }
+        printf("%c (%.4f)\n", 'A' + best, model.unigram[best]);
+    }
+    lang_model_close(&model);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,222 @@
+#include <stdlib.h>
+#include <string.h>
+#include "ngram.h"
+
+/* Up to 13 letters the base-26 code fits in 64 bits and is the n-gram
+ * itself; longer n-grams use a wrapping polynomial hash and are compared */
+#define NGRAM_EXACT 13
+#define NGRAM_BASE 0x100000001B3ull
+#define NGRAM_EMPTY UINT32_MAX
+
+/* Positions the table slot is prefetched ahead of its probe */
+#define NGRAM_PREFETCH 16
+
+/* Rolling hash of the n-gram starting at the next position */
+typedef struct {
+    const char *text;
+    uint64_t h;        /* hash of the first n-1 characters */
+    uint64_t base;
+    uint64_t top;      /* base^(n-1), weight of the outgoing character */
+    int n;
+} ROLL;
+
+static inline void roll_init(ROLL *r, const char *text, size_t at, int n, uint64_t base, uint64_t top){
+    r->text = text;
+    r->h = 0;
+    r->base = base;
+    r->top = top;
+    r->n = n;
+    for (int k = 0; k < n - 1; k++)
+        r->h = r->h * base + (uint64_t)(text[at + k] - 'A');
+}
+
+/* Hash of the n-gram at i, then slides past it; i advances by one per call */
+static inline uint64_t roll_next(ROLL *r, size_t i){
+    uint64_t out = r->h * r->base + (uint64_t)(r->text[i + r->n - 1] - 'A');
+    r->h = out - (uint64_t)(r->text[i] - 'A') * r->top;
+    return out;
+}
+
+static inline size_t slot_of(uint64_t hash, size_t capacity){
+    /* Base-26 codes are far from uniform, spread them before masking */
+    return (size_t)((hash * 0x9E3779B97F4A7C15ull) >> 17) & (capacity - 1);
+}
+
+static uint64_t power_of(uint64_t base, int e){
+    uint64_t p = 1;
+    while (e-- > 0)
+        p *= base;
+    return p;
+}
+
+/* Slot holding the n-gram at position at (hash h), or the empty slot where it goes */
+static size_t probe(const NGRAM_INDEX *idx, uint64_t h, const char *gram){
+    size_t mask = idx->capacity - 1;
+    size_t s = slot_of(h, idx->capacity);
+
+    for (;; s = (s + 1) & mask) {
+        const NGRAM_ENTRY *e = &idx->table[s];
+        if (e->first == NGRAM_EMPTY)
+            return s;
+        if (e->hash == h && (idx->n <= NGRAM_EXACT
+                || memcmp(idx->text + e->first, gram, idx->n) == 0))
+            return s;
+    }
+}
+
+static int grow(NGRAM_INDEX *idx){
+    size_t capacity = idx->capacity * 2;
+    NGRAM_ENTRY *old = idx->table;
+    size_t old_capacity = idx->capacity;
+    NGRAM_ENTRY *table = malloc(capacity * sizeof(NGRAM_ENTRY));
+
+    if (!table)
+        return -1;
+    for (size_t s = 0; s < capacity; s++)
+        table[s].first = NGRAM_EMPTY;
+    idx->table = table;
+    idx->capacity = capacity;
+
+    /* Entries are distinct, they only need an empty slot */
+    for (size_t s = 0; s < old_capacity; s++) {
+        if (old[s].first != NGRAM_EMPTY) {
+            size_t t = slot_of(old[s].hash, capacity);
+            while (table[t].first != NGRAM_EMPTY)
+                t = (t + 1) & (capacity - 1);
+            table[t] = old[s];
+        }
+    }
+    free(old);
+    return 0;
+}
+
+int ngram_index_build(NGRAM_INDEX *idx, const char *text, size_t length, int n, size_t min_count){
+    uint64_t base = (n <= NGRAM_EXACT) ? 26 : NGRAM_BASE;
+    uint64_t top = power_of(base, n - 1);
+    uint64_t h;
+    size_t total = 0;
+    ROLL cur, ahead;
+
+    memset(idx, 0, sizeof(*idx));
+    idx->text = text;
+    idx->length = length;
+    idx->n = n;
+    idx->capacity = 1024;
+    idx->table = malloc(idx->capacity * sizeof(NGRAM_ENTRY));
+    if (!idx->table)
+        return -1;
+    for (size_t s = 0; s < idx->capacity; s++)
+        idx->table[s].first = NGRAM_EMPTY;
+
+    if (n < 1 || length < (size_t)n)
+        goto lists;
+
+    /* Pass 1: distinct n-grams and their counts */
+    roll_init(&cur, text, 0, n, base, top);
+    roll_init(&ahead, text, 0, n, base, top);
+    for (size_t i = 0; i < NGRAM_PREFETCH && i + n <= length; i++)
+        roll_next(&ahead, i);
+    for (size_t i = 0; i + n <= length; i++) {
+        NGRAM_ENTRY *e;
+
+        if (i + NGRAM_PREFETCH + n <= length)
+            __builtin_prefetch(&idx->table[slot_of(roll_next(&ahead, i + NGRAM_PREFETCH), idx->capacity)]);
+        h = roll_next(&cur, i);
+        e = &idx->table[probe(idx, h, text + i)];
+        if (e->first == NGRAM_EMPTY) {
+            e->hash = h;
+            e->first = (uint32_t)i;
+            e->count = 1;
+            e->group = NGRAM_EMPTY;
+            /* Keep the load factor under one half */
+            if (++idx->distinct * 2 > idx->capacity && grow(idx) != 0) {
+                ngram_index_free(idx);
+                return -1;
+            }
+        } else {
+            e->count++;
+        }
+    }
+
+lists:
+    for (size_t s = 0; s < idx->capacity; s++) {
+        if (idx->table[s].first != NGRAM_EMPTY && idx->table[s].count >= min_count) {
+            idx->groups++;
+            total += idx->table[s].count;
+        }
+    }
+    idx->start = malloc((idx->groups + 1) * sizeof(uint32_t));
+    idx->pos = malloc((total + 1) * sizeof(uint32_t));
+    if (!idx->start || !idx->pos) {
+        ngram_index_free(idx);
+        return -1;
+    }
+    idx->start[0] = 0;
+    if (idx->groups == 0)
+        return 0;
+
+    /* Pass 2: groups numbered at their first occurrence, start[g + 1] is
+     * the fill cursor of group g and ends as the start of group g + 1 */
+    {
+        uint32_t next = 0, used = 0;
+
+        roll_init(&cur, text, 0, n, base, top);
+        roll_init(&ahead, text, 0, n, base, top);
+        for (size_t i = 0; i < NGRAM_PREFETCH && i + n <= length; i++)
+            roll_next(&ahead, i);
+        for (size_t i = 0; i + n <= length; i++) {
+            NGRAM_ENTRY *e;
+
+            if (i + NGRAM_PREFETCH + n <= length)
+                __builtin_prefetch(&idx->table[slot_of(roll_next(&ahead, i + NGRAM_PREFETCH), idx->capacity)]);
+            h = roll_next(&cur, i);
+            e = &idx->table[probe(idx, h, text + i)];
+            if (e->count >= min_count) {
+                if (e->first == i) {
+                    e->group = next++;
+                    idx->start[e->group + 1] = used;
+                    used += e->count;
+                }
+                idx->pos[idx->start[e->group + 1]++] = (uint32_t)i;
+            }
+        }
+    }
+    return 0;
+}
+
+void ngram_index_free(NGRAM_INDEX *idx){
+    free(idx->table);
+    free(idx->start);
+    free(idx->pos);
+    idx->table = NULL;
+    idx->start = NULL;
+    idx->pos = NULL;
+    idx->capacity = 0;
+    idx->distinct = 0;
+    idx->groups = 0;
+}
+
+size_t ngram_lookup(const NGRAM_INDEX *idx, const char *gram, const uint32_t **pos){
+    uint64_t base = (idx->n <= NGRAM_EXACT) ? 26 : NGRAM_BASE;
+    uint64_t h = 0;
+    const NGRAM_ENTRY *e;
+
+    if (pos)
+        *pos = NULL;
+    for (int k = 0; k < idx->n; k++) {
+        if (gram[k] < 'A' || gram[k] > 'Z')
+            return 0;
+        h = h * base + (uint64_t)(gram[k] - 'A');
+    }
+    e = &idx->table[probe(idx, h, gram)];
+    if (e->first == NGRAM_EMPTY)
+        return 0;
+    if (pos && e->group != NGRAM_EMPTY)
+        *pos = idx->pos + idx->start[e->group];
+    return e->count;
+}
+
+void ngram_index_foreach(const NGRAM_INDEX *idx, NGRAM_GROUP_FN fn, void *arg){
+    for (size_t g = 0; g < idx->groups; g++)
+        fn(idx->pos + idx->start[g], idx->start[g + 1] - idx->start[g], idx->n, arg);
+}
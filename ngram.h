@@ -0,0 +1,49 @@
+#ifndef NGRAM_H
+#define NGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Called for each indexed n-gram: its count occurrences, sorted increasing,
+ * each len characters long. Same shape as SUFFIX_REPEAT_FN. */
+typedef void (*NGRAM_GROUP_FN)(const uint32_t *pos, size_t count, size_t len, void *arg);
+
+/* One distinct n-gram in the open-addressing table */
+typedef struct {
+    uint64_t hash;     /* rolling hash, the exact base-26 code when n <= 13 */
+    uint32_t first;    /* first occurrence, UINT32_MAX for an empty slot */
+    uint32_t count;    /* number of occurrences */
+    uint32_t group;    /* position list index, UINT32_MAX if not kept */
+} NGRAM_ENTRY;
+
+/* Index of the n-grams of an A–Z text. Distinct n-grams live in a hash
+ * table; the occurrences of those seen at least min_count times are stored
+ * as compressed lists: group g is pos[start[g]..start[g+1]), and groups
+ * are numbered in order of first occurrence. */
+typedef struct {
+    const char *text;
+    size_t length;
+    int n;
+    NGRAM_ENTRY *table;
+    size_t capacity;   /* slots, a power of two */
+    size_t distinct;   /* distinct n-grams */
+    uint32_t *start;   /* groups + 1 offsets into pos */
+    uint32_t *pos;
+    size_t groups;
+} NGRAM_INDEX;
+
+/* Indexes the n-grams of text (A–Z only, length below 2^32) with a
+ * Rabin-Karp rolling hash, keeping the positions of the n-grams that occur
+ * at least min_count times. Returns 0, or -1 if memory runs out. */
+int ngram_index_build(NGRAM_INDEX *idx, const char *text, size_t length, int n, size_t min_count);
+
+void ngram_index_free(NGRAM_INDEX *idx);
+
+/* Number of occurrences of the n characters at gram. If pos is not NULL it
+ * receives the position list, or NULL when the n-gram was not kept. */
+size_t ngram_lookup(const NGRAM_INDEX *idx, const char *gram, const uint32_t **pos);
+
+/* Calls fn for every kept n-gram, in order of first occurrence */
+void ngram_index_foreach(const NGRAM_INDEX *idx, NGRAM_GROUP_FN fn, void *arg);
+
+#endif
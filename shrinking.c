@@ -0,0 +1,480 @@
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include "shrinking.h"
+#include "utils.h"
+
+/* compress_table[c][d]: bits of d selected by c, packed to the bottom */
+static uint8_t compress_table[256][256];
+static pthread_once_t compress_once = PTHREAD_ONCE_INIT;
+
+static void compress_table_init(void){
+    for (int c = 0; c < 256; c++) {
+        for (int d = 0; d < 256; d++) {
+            int packed = 0, k = 0;
+            for (int bit = 0; bit < 8; bit++) {
+                if ((c >> bit) & 1)
+                    packed |= ((d >> bit) & 1) << k++;
+            }
+            compress_table[c][d] = (uint8_t)packed;
+        }
+    }
+}
+
+/* Transition tables of the two stream cipher registers, built once */
+static LFSR_TABLE stream_tables[2];
+static pthread_once_t stream_tables_once = PTHREAD_ONCE_INIT;
+
+static void stream_tables_init(void){
+    lfsr_table_init(&stream_tables[0], STREAM_MASK1, 32);
+    lfsr_table_init(&stream_tables[1], STREAM_MASK2, 32);
+}
+
+/* In-place transpose of a 64x64 bit matrix: bit j of a[i] <-> bit i of a[j] */
+static void transpose64(uint64_t a[64]){
+    int j, k;
+    uint64_t m, t;
+
+    for (j = 32, m = 0x00000000FFFFFFFFULL; j; j >>= 1, m ^= m << j) {
+        for (k = 0; k < 64; k = ((k | j) + 1) & ~j) {
+            t = ((a[k] >> j) ^ a[k | j]) & m;
+            a[k] ^= t << j;
+            a[k | j] ^= t;
+        }
+    }
+}
+
+/* Positions of the taps of a feedback mask, returns how many */
+static int mask_taps(uint32_t mask, int taps[32]){
+    int n = 0;
+    for (int j = 0; j < 32; j++) {
+        if ((mask >> j) & 1)
+            taps[n++] = j;
+    }
+    return n;
+}
+
+uint64_t shrinking_compress(uint64_t data, uint64_t control){
+    uint64_t packed = 0;
+    int shift = 0;
+
+    pthread_once(&compress_once, compress_table_init);
+
+    for (int b = 0; b < 64 && control; b += 8) {
+        unsigned c = (control >> b) & 0xff;
+        packed |= (uint64_t)compress_table[c][(data >> b) & 0xff] << shift;
+        shift += __builtin_popcount(c);
+    }
+    return packed;
+}
+
+void shrinking_init(SHRINKING *ctx, uint32_t seed1, uint32_t seed2){
+    LFSR r1, r2;
+
+    lfsr_init(&r1, seed1, STREAM_MASK1, 32);
+    lfsr_init(&r2, seed2, STREAM_MASK2, 32);
+    shrinking_init_registers(ctx, &r1, &r2);
+}
+
+void shrinking_init_registers(SHRINKING *ctx, const LFSR *r1, const LFSR *r2){
+    pthread_once(&stream_tables_once, stream_tables_init);
+
+    ctx->r1 = *r1;
+    ctx->r2 = *r2;
+    ctx->t1 = &stream_tables[0];
+    ctx->t2 = &stream_tables[1];
+    ctx->acc = 0;
+    ctx->acc_bits = 0;
+}
+
+/* Appends the shrinking output of 32 more register steps to acc.
+ * Callers only refill below 32 pending bits, so acc never overflows. */
+static inline void shrinking_refill(SHRINKING *ctx){
+    uint64_t control = lfsr_next_bits(&ctx->r1, ctx->t1, 32);
+    uint64_t data = lfsr_next_bits(&ctx->r2, ctx->t2, 32);
+
+    ctx->acc |= shrinking_compress(data, control) << ctx->acc_bits;
+    ctx->acc_bits += __builtin_popcountll(control);
+}
+
+void shrinking_keystream_fill(SHRINKING *ctx, uint8_t *out, size_t n){
+    size_t i = 0;
+
+    while (i < n) {
+        if (ctx->acc_bits < 8) {
+            shrinking_refill(ctx);
+            continue;
+        }
+        out[i++] = (uint8_t)ctx->acc;
+        ctx->acc >>= 8;
+        ctx->acc_bits -= 8;
+    }
+}
+
+void shrinking_symbol_fill(SHRINKING *ctx, uint8_t *out, size_t n, int width){
+    uint64_t low = (1ULL << width) - 1;
+
+    for (size_t i = 0; i < n; i++) {
+        uint64_t bits;
+        uint8_t symbol = 0;
+
+        while (ctx->acc_bits < width)
+            shrinking_refill(ctx);
+
+        bits = ctx->acc & low;
+        ctx->acc >>= width;
+        ctx->acc_bits -= width;
+
+        /* The first keystream bit is the most significant one of the symbol */
+        for (int b = 0; b < width; b++) {
+            symbol = (symbol << 1) | ((bits >> b) & 1);
+        }
+        out[i] = symbol;
+    }
+}
+
+void shrinking_slice_init(SHRINKING_SLICE *s, const uint32_t *seed1, const uint32_t *seed2, int lanes){
+    uint64_t a[64], b[64];
+
+    for (int l = 0; l < 64; l++) {
+        a[l] = (l < lanes) ? seed1[l] : 1;
+        b[l] = (l < lanes) ? seed2[l] : 1;
+    }
+    /* Row l holds lane l's seed, after the transpose row j holds bit j */
+    transpose64(a);
+    transpose64(b);
+    for (int j = 0; j < 32; j++) {
+        s->r1[j] = a[j];
+        s->r2[j] = b[j];
+    }
+    s->head = 0;
+}
+
+void shrinking_slice_next(SHRINKING_SLICE *s, uint64_t control[SHRINKING_LANES], uint64_t data[SHRINKING_LANES]){
+    int taps1[32], taps2[32];
+    int n1 = mask_taps(STREAM_MASK1, taps1);
+    int n2 = mask_taps(STREAM_MASK2, taps2);
+    int h = s->head;
+
+    for (int t = 0; t < 64; t++) {
+        uint64_t f1 = 0, f2 = 0;
+
+        for (int k = 0; k < n1; k++)
+            f1 ^= s->r1[(h + taps1[k]) & 31];
+        for (int k = 0; k < n2; k++)
+            f2 ^= s->r2[(h + taps2[k]) & 31];
+
+        /* Output bit 0, then the freed word becomes the new bit 31 */
+        control[t] = s->r1[h];
+        data[t] = s->r2[h];
+        s->r1[h] = f1;
+        s->r2[h] = f2;
+        h = (h + 1) & 31;
+    }
+    s->head = h;
+
+    /* Row t holds step t of every lane, after the transpose row l holds lane l */
+    transpose64(control);
+    transpose64(data);
+}
+
+void shrinking_batch(const uint32_t *seed1, const uint32_t *seed2, size_t count, uint8_t *out, size_t nbytes){
+    SHRINKING_SLICE s;
+    uint64_t control[SHRINKING_LANES], data[SHRINKING_LANES];
+    uint64_t acc[SHRINKING_LANES];
+    int acc_bits[SHRINKING_LANES];
+    size_t written[SHRINKING_LANES];
+
+    for (size_t base = 0; base < count; base += SHRINKING_LANES) {
+        int lanes = (count - base < SHRINKING_LANES) ? (int)(count - base) : SHRINKING_LANES;
+        int pending = (nbytes > 0) ? lanes : 0;
+
+        shrinking_slice_init(&s, seed1 + base, seed2 + base, lanes);
+        for (int l = 0; l < lanes; l++) {
+            acc[l] = 0;
+            acc_bits[l] = 0;
+            written[l] = 0;
+        }
+
+        while (pending > 0) {
+            shrinking_slice_next(&s, control, data);
+
+            for (int l = 0; l < lanes; l++) {
+                uint8_t *lane_out = out + (base + l) * nbytes;
+                uint64_t bits;
+                int k;
+
+                if (written[l] == nbytes)
+                    continue;
+
+                bits = shrinking_compress(data[l], control[l]);
+                k = __builtin_popcountll(control[l]);
+
+                /* acc_bits stays below 8, so 56 new bits always fit */
+                while (k > 0 && written[l] < nbytes) {
+                    int take = (k > 56) ? 56 : k;
+                    acc[l] |= (bits & ((1ULL << take) - 1)) << acc_bits[l];
+                    acc_bits[l] += take;
+                    bits >>= take;
+                    k -= take;
+                    while (acc_bits[l] >= 8 && written[l] < nbytes) {
+                        lane_out[written[l]++] = (uint8_t)acc[l];
+                        acc[l] >>= 8;
+                        acc_bits[l] -= 8;
+                    }
+                }
+                if (written[l] == nbytes)
+                    pending--;
+            }
+
+            /* A lane whose control register has drained to zero never selects
+             * another bit: flush its last bits and zero-fill the rest */
+            uint64_t alive = 0;
+            for (int j = 0; j < 32; j++)
+                alive |= s.r1[j];
+            for (int l = 0; l < lanes; l++) {
+                uint8_t *lane_out = out + (base + l) * nbytes;
+
+                if (written[l] == nbytes || ((alive >> l) & 1))
+                    continue;
+                if (acc_bits[l] > 0)
+                    lane_out[written[l]++] = (uint8_t)acc[l];
+                memset(lane_out + written[l], 0, nbytes - written[l]);
+                written[l] = nbytes;
+                pending--;
+            }
+        }
+    }
+}
+
+/* Pairs handed to a search thread at a time */
+#define SEARCH_BLOCK (1u << 20)
+
+/* Shared state of the search threads, guarded by lock */
+typedef struct {
+    SHRINKING_SEARCH *search;
+    const uint8_t *known;
+    size_t length;
+    uint64_t known_word;     /* first 64 known keystream bits */
+    int known_bits;          /* how many of them exist */
+    uint64_t next_block;     /* first index not handed out */
+    uint64_t *current;       /* block each thread works on, UINT64_MAX if idle */
+    uint64_t explored;       /* pairs tried so far */
+    int stop;
+    int running;
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+} SEARCH_JOB;
+
+typedef struct {
+    SEARCH_JOB *job;
+    int id;
+    int started;
+} SEARCH_WORKER;
+
+static int search_verify(const SEARCH_JOB *job, uint32_t seed1, uint32_t seed2){
+    SHRINKING ctx;
+    uint8_t key[256];
+
+    shrinking_init(&ctx, seed1, seed2);
+    for (size_t i = 0; i < job->length; i += sizeof(key)) {
+        size_t len = (job->length - i < sizeof(key)) ? job->length - i : sizeof(key);
+        shrinking_keystream_fill(&ctx, key, len);
+        if (memcmp(key, job->known + i, len) != 0)
+            return 0;
+    }
+    return 1;
+}
+
+static void *search_worker(void *arg){
+    SEARCH_WORKER *w = arg;
+    SEARCH_JOB *job = w->job;
+    SHRINKING_SEARCH *search = job->search;
+    uint64_t n2 = (uint64_t)search->d_hi - search->d_lo + 1;
+    SHRINKING tables;
+
+    shrinking_init(&tables, 1, 1);
+
+    for (;;) {
+        uint64_t start, end, idx;
+
+        pthread_mutex_lock(&job->lock);
+        if (job->stop || job->next_block >= search->total) {
+            job->current[w->id] = UINT64_MAX;
+            job->running--;
+            pthread_cond_signal(&job->done);
+            pthread_mutex_unlock(&job->lock);
+            return NULL;
+        }
+        start = job->next_block;
+        end = (search->total - start < SEARCH_BLOCK) ? search->total : start + SEARCH_BLOCK;
+        job->next_block = end;
+        job->current[w->id] = start;
+        pthread_mutex_unlock(&job->lock);
+
+        idx = start;
+        while (idx < end && !__atomic_load_n(&job->stop, __ATOMIC_RELAXED)) {
+            uint64_t i1 = idx / n2;
+            uint64_t run_end = ((i1 + 1) * n2 < end) ? (i1 + 1) * n2 : end;
+            uint32_t seed1 = search->c_lo + (uint32_t)i1;
+            uint32_t seed2 = search->d_lo + (uint32_t)(idx % n2);
+            uint64_t tried = run_end - idx;
+            LFSR r1;
+
+            /* The control word only depends on seed1, compute it once per run */
+            lfsr_init(&r1, seed1, STREAM_MASK1, 32);
+            uint64_t control = lfsr_next_bits(&r1, tables.t1, 64);
+
+            /* The taps do not include bit 0, so some seeds (0, 1, ...) drain the
+             * control register: zero after 64 steps means zero forever, and the
+             * keystream stops, so no known text can be checked against it */
+            if (r1.state == 0) {
+                idx = run_end;
+                __atomic_fetch_add(&job->explored, tried, __ATOMIC_RELAXED);
+                continue;
+            }
+            int check = __builtin_popcountll(control);
+            if (check > job->known_bits)
+                check = job->known_bits;
+            uint64_t check_mask = (check == 64) ? ~0ULL : ((1ULL << check) - 1);
+            uint64_t expected = job->known_word & check_mask;
+
+            for (; idx < run_end; idx++, seed2++) {
+                LFSR r2;
+
+                if (seed2 == 0)
+                    continue;
+                lfsr_init(&r2, seed2, STREAM_MASK2, 32);
+                uint64_t data = lfsr_next_bits(&r2, tables.t2, 64);
+                if ((shrinking_compress(data, control) & check_mask) != expected)
+                    continue;
+                if (!search_verify(job, seed1, seed2))
+                    continue;
+
+                pthread_mutex_lock(&job->lock);
+                if (!search->found) {
+                    search->found = 1;
+                    search->seed1 = seed1;
+                    search->seed2 = seed2;
+                }
+                __atomic_store_n(&job->stop, 1, __ATOMIC_RELAXED);
+                pthread_mutex_unlock(&job->lock);
+                break;
+            }
+            __atomic_fetch_add(&job->explored, tried, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/* Lowest index that may still be unexplored. Caller holds the lock. */
+static uint64_t search_frontier(const SEARCH_JOB *job, int nthreads){
+    uint64_t frontier = job->next_block;
+
+    for (int t = 0; t < nthreads; t++) {
+        if (job->current[t] < frontier)
+            frontier = job->current[t];
+    }
+    return frontier;
+}
+
+static double search_seconds(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void shrinking_search_init(SHRINKING_SEARCH *search, uint32_t c_lo, uint32_t c_hi, uint32_t d_lo, uint32_t d_hi){
+    search->c_lo = c_lo;
+    search->c_hi = c_hi;
+    search->d_lo = d_lo;
+    search->d_hi = d_hi;
+    search->next = 0;
+    search->total = ((uint64_t)c_hi - c_lo + 1) * ((uint64_t)d_hi - d_lo + 1);
+    search->found = 0;
+    search->seed1 = 0;
+    search->seed2 = 0;
+}
+
+void shrinking_search(SHRINKING_SEARCH *search, const uint8_t *known, size_t length, int nthreads, SHRINKING_PROGRESS progress, void *arg){
+    SEARCH_JOB job;
+    pthread_t *threads;
+    SEARCH_WORKER *workers;
+    double t_start, t_last;
+    uint64_t explored_last = 0;
+
+    if (nthreads < 1)
+        nthreads = 1;
+    if (length == 0 || search->next >= search->total)
+        return;
+
+    job.search = search;
+    job.known = known;
+    job.length = length;
+    job.known_word = 0;
+    job.known_bits = (length < 8) ? (int)length * 8 : 64;
+    for (int i = 0; i < job.known_bits / 8; i++)
+        job.known_word |= (uint64_t)known[i] << (8 * i);
+    job.next_block = search->next;
+    job.current = malloc(nthreads * sizeof(uint64_t));
+    job.explored = 0;
+    job.stop = 0;
+    job.running = 0;
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.done, NULL);
+
+    threads = malloc(nthreads * sizeof(pthread_t));
+    workers = malloc(nthreads * sizeof(SEARCH_WORKER));
+
+    pthread_mutex_lock(&job.lock);
+    for (int t = 0; t < nthreads; t++) {
+        workers[t].job = &job;
+        workers[t].id = t;
+        job.current[t] = UINT64_MAX;
+        workers[t].started = (pthread_create(&threads[t], NULL, search_worker, &workers[t]) == 0);
+        job.running += workers[t].started;
+    }
+    pthread_mutex_unlock(&job.lock);
+
+    if (job.running == 0) {
+        /* Could not spawn any thread, search in this one */
+        job.running = 1;
+        search_worker(&workers[0]);
+    }
+
+    t_start = t_last = search_seconds();
+    pthread_mutex_lock(&job.lock);
+    while (job.running > 0) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += 1;
+        if (pthread_cond_timedwait(&job.done, &job.lock, &deadline) == 0)
+            continue;
+
+        /* Report progress without holding the lock */
+        double now = search_seconds();
+        uint64_t explored = __atomic_load_n(&job.explored, __ATOMIC_RELAXED);
+        search->next = search_frontier(&job, nthreads);
+        pthread_mutex_unlock(&job.lock);
+        if (progress)
+            progress(search, (explored - explored_last) / (now - t_last), arg);
+        explored_last = explored;
+        t_last = now;
+        pthread_mutex_lock(&job.lock);
+    }
+    if (!search->found)
+        search->next = search->total;
+    pthread_mutex_unlock(&job.lock);
+
+    for (int t = 0; t < nthreads; t++) {
+        if (workers[t].started)
+            pthread_join(threads[t], NULL);
+    }
+    if (progress)
+        progress(search, job.explored / (search_seconds() - t_start), arg);
+
+    pthread_mutex_destroy(&job.lock);
+    pthread_cond_destroy(&job.done);
+    free(job.current);
+    free(threads);
+    free(workers);
+}
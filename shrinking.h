@@ -0,0 +1,85 @@
+#ifndef SHRINKING_H
+#define SHRINKING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "lfsr.h"
+
+/* Number of (seed1, seed2) pairs stepped together by the bit-sliced engine */
+#define SHRINKING_LANES 64
+
+/* Bit-sliced pair of stream cipher registers: word j holds bit j of every
+ * lane, so one XOR of words steps 64 independent LFSRs at once. */
+typedef struct {
+    uint64_t r1[32];  /* control registers (taps STREAM_MASK1) */
+    uint64_t r2[32];  /* data registers (taps STREAM_MASK2) */
+    int head;         /* word currently holding bit 0 */
+} SHRINKING_SLICE;
+
+/* Shrinking generator with the stream cipher taps, producing whole buffers
+ * of keystream. Keystream bits not yet handed out wait in acc. */
+typedef struct {
+    LFSR r1;                 /* control register */
+    LFSR r2;                 /* data register */
+    const LFSR_TABLE *t1;    /* shared tables for STREAM_MASK1 */
+    const LFSR_TABLE *t2;    /* shared tables for STREAM_MASK2 */
+    uint64_t acc;            /* pending keystream bits, first in the LSB */
+    int acc_bits;            /* number of pending bits */
+} SHRINKING;
+
+/* Starts a generator from the stream cipher seeds */
+void shrinking_init(SHRINKING *ctx, uint32_t seed1, uint32_t seed2);
+
+/* Starts a generator from register states, e.g. a shrinking_seek checkpoint */
+void shrinking_init_registers(SHRINKING *ctx, const LFSR *r1, const LFSR *r2);
+
+/* Writes the next n keystream bytes: 8 bits each, first bit in the LSB
+ * (the bytes stream_cipher XORs with) */
+void shrinking_keystream_fill(SHRINKING *ctx, uint8_t *out, size_t n);
+
+/* Writes the next n keystream symbols of width (1..8) bits each, first bit
+ * in the MSB (the keys stream_cipher_mod adds before reducing) */
+void shrinking_symbol_fill(SHRINKING *ctx, uint8_t *out, size_t n, int width);
+
+/* Packs the bits of data selected by the ones of control into the low bits
+ * of the result, in order. This is the shrinking rule on 64 steps at once. */
+uint64_t shrinking_compress(uint64_t data, uint64_t control);
+
+/* Loads up to SHRINKING_LANES seed pairs; unused lanes get seed 1 */
+void shrinking_slice_init(SHRINKING_SLICE *s, const uint32_t *seed1, const uint32_t *seed2, int lanes);
+
+/* Steps every lane 64 times. control[l] and data[l] receive the 64 output
+ * bits of lane l's registers, bit t being step t. */
+void shrinking_slice_next(SHRINKING_SLICE *s, uint64_t control[SHRINKING_LANES], uint64_t data[SHRINKING_LANES]);
+
+/* Generates nbytes of keystream for each of count seed pairs, the keystream
+ * of pair k going to out + k * nbytes. Bytes are the ones stream_cipher
+ * XORs with its input (8 shrinking bits, first bit in the LSB). Once the
+ * control register of a pair drains to zero (seed1 0 or 1, for instance)
+ * it outputs no more bits; the rest of its bytes are left zero. */
+void shrinking_batch(const uint32_t *seed1, const uint32_t *seed2, size_t count, uint8_t *out, size_t nbytes);
+
+/* State of a known-plaintext seed search over inclusive seed ranges.
+ * Pairs are numbered seed1-major: index = (seed1 - c_lo) * #d + (seed2 - d_lo). */
+typedef struct {
+    uint32_t c_lo, c_hi;     /* control seed range */
+    uint32_t d_lo, d_hi;     /* data seed range */
+    uint64_t next;           /* every pair below this index has been explored */
+    uint64_t total;          /* number of pairs in the ranges */
+    int found;               /* 1 once a matching pair is found */
+    uint32_t seed1, seed2;   /* the matching pair */
+} SHRINKING_SEARCH;
+
+/* Called about once per second while searching */
+typedef void (*SHRINKING_PROGRESS)(const SHRINKING_SEARCH *search, double keys_per_second, void *arg);
+
+/* Sets the ranges of a new search, starting at index 0 */
+void shrinking_search_init(SHRINKING_SEARCH *search, uint32_t c_lo, uint32_t c_hi, uint32_t d_lo, uint32_t d_hi);
+
+/* Looks for the seeds whose keystream starts with known[0..length), trying
+ * pairs from search->next on with nthreads threads. Candidates are dropped
+ * at the first 64-step word whose shrunk bits disagree; survivors are checked
+ * over the whole known keystream. Returns when found or exhausted. */
+void shrinking_search(SHRINKING_SEARCH *search, const uint8_t *known, size_t length, int nthreads, SHRINKING_PROGRESS progress, void *arg);
+
+#endif
@@ -6,10 +6,6 @@
 #include <math.h>
 #include "utils.h"
 
-#define IC_RANDOM 0.0385
-#define IC_ENGLISH 0.0650
-#define IC_SPANISH 0.0770
-
 int main(int argc, char *argv[]) {
     int opt;
     int n = -1; /* Key size */
@@ -17,11 +13,17 @@ int main(int argc, char *argv[]) {
     char *output_filename = NULL;
     FILE *output_file = NULL;
     int language = 0; /* 0 for English, 1 for Spanish (DEFAULT: ENGLISH)*/  
+    int nthreads = default_threads();
+    char *model_filename = NULL; /* Overrides -l */
+    LANG_MODEL loaded;
+    const LANG_MODEL *model;
+    int top_k = 1; /* Shifts listed per key letter */
+    int method = SCORE_CORRELATION;
 
     int i;
 
     /* Parse command line arguments */
-    while ((opt = getopt(argc, argv, "n:i:o:l:")) != -1) {
+    while ((opt = getopt(argc, argv, "n:i:o:l:L:t:k:s:")) != -1) {
         switch (opt) {
             case 'n':
                 n = atoi(optarg);
@@ -35,101 +37,81 @@ int main(int argc, char *argv[]) {
             case 'l':
                 language = atoi(optarg);
                 break;
+            case 'L':
+                model_filename = optarg;
+                break;
+            case 't':
+                nthreads = atoi(optarg);
+                break;
+            case 'k':
+                top_k = atoi(optarg);
+                break;
+            case 's':
+                method = atoi(optarg);
+                break;
             default:
-                fprintf(stderr, "Usage: %s [-n n] [-l language (0 for english / 1 for spanish)] [-i infile] [-o outfile]\n", argv[0]);
+                fprintf(stderr, "Usage: %s [-n n] [-l language (0 for english / 1 for spanish)] [-L modelfile] [-t threads] [-k shifts per letter] [-s score (0 correlation / 1 chi-squared)] [-i infile] [-o outfile]\n", argv[0]);
                 return EXIT_FAILURE;
         }
     }
 
-   /*Open the input file for reading*/
-    char *temp = NULL;
-    size_t bytes_read = 0;
-
-    if (input_filename == NULL) {
-        /* Leer desde stdin */
-        size_t capacity = 1024;
-        temp = malloc(capacity);
-        if (!temp) {
-            perror("malloc");
+    /*Language model: builtin unless a model file is given*/
+    model = lang_model_builtin(language);
+    if (model_filename != NULL) {
+        if (lang_model_load(&loaded, model_filename) != 0) {
+            perror("Error loading model file");
             return EXIT_FAILURE;
         }
-    
-        int c;
-        while ((c = fgetc(stdin)) != EOF) {
-            if (bytes_read + 1 >= capacity) {
-                capacity *= 2;
-                temp = realloc(temp, capacity);
-                if (!temp) {
-                    perror("realloc");
-                    return EXIT_FAILURE;
-                }
-            }
-            temp[bytes_read++] = (char)c;
-        }
-        temp[bytes_read] = '\0';
-    } else {
-        /* Leer desde archivo */
-        FILE *input_file = fopen(input_filename, "rb");
-        if (input_file == NULL) {
-            perror("Error opening input file");
-            return EXIT_FAILURE;
-        }
-
-        fseek(input_file, 0, SEEK_END);
-        bytes_read = ftell(input_file);
-        rewind(input_file);
-
-        temp = malloc(bytes_read + 1);
-        if (!temp) {
-            perror("malloc");
-            fclose(input_file);
-            return EXIT_FAILURE;
-        }
-
-        if (fread(temp, 1, bytes_read, input_file) != bytes_read) {
-            perror("Error reading file");
-            fclose(input_file);
-            free(temp);
-            return EXIT_FAILURE;
-        }
-        temp[bytes_read] = '\0';
-        
-        fclose(input_file);
+        model = &loaded;
     }
 
-    /* Normalize input to A-Z */
-    char *buffer = malloc(bytes_read);
+    /*Read and normalize the input to A-Z*/
+    size_t bytes_read = 0;
+    char *buffer = read_text_AZ(input_filename, &bytes_read);
+    if (buffer == NULL) {
+        perror("Error reading input");
+        return EXIT_FAILURE;
+    }
 
-    int purged = normalize_AZ(temp, bytes_read, buffer);
-    bytes_read = bytes_read - purged;
+    if (top_k < 1 || top_k > 26 || (method != SCORE_CORRELATION && method != SCORE_CHI_SQUARED)) {
+        fprintf(stderr, "Error: -k must be in 1..26 and -s 0 or 1.\n");
+        free(buffer);
+        return EXIT_FAILURE;
+    }
 
     if (n <= 0){
-        n = bytes_read; /*Default try all n possible*/
+        n = ic_default_bound(bytes_read); /*Default try n up to IC_MAX_PERIOD*/
     }
 
     double best_ic = 0.0;
     int best_ic_idx = 0;
 
-    /*Calculate probable key length*/
-    for (i = 1; i < n; i++){
-        double ic = calculate_ic(buffer, bytes_read, i);
-
-        if (language == 1) { 
-            if (fabs(ic - IC_SPANISH) < fabs(best_ic - IC_SPANISH)){
-                best_ic = ic;
-                best_ic_idx = i;
-            }
-        } else{
-            if (fabs(ic - IC_ENGLISH) < fabs(best_ic - IC_ENGLISH)){
-                best_ic = ic;
-                best_ic_idx = i;
-            }
-        }
+    /*IC of every candidate key length in one scan*/
+    double *profile = malloc(n * sizeof(double));
+    if (!profile || ic_profile(buffer, bytes_read, n, profile, nthreads) != 0) {
+        perror("malloc");
+        free(profile);
+        free(buffer);
+        return EXIT_FAILURE;
     }
 
-    /*Calculate probable key*/
+    /*Calculate probable key length*/
+    best_ic_idx = ic_best_period(profile, n, model->ic, &best_ic);
+
+    /*Calculate probable key: the best shift of every column*/
     char probable_key[best_ic_idx + 1];
-    find_probable_key(buffer, bytes_read, best_ic_idx, probable_key, language);
+    SHIFT_SCORE *ranked = malloc(((size_t)best_ic_idx * top_k + 1) * sizeof(SHIFT_SCORE));
+    if (!ranked) {
+        perror("malloc");
+        free(profile);
+        free(buffer);
+        return EXIT_FAILURE;
+    }
+    rank_key_shifts(buffer, bytes_read, best_ic_idx, model->unigram, method, top_k, ranked);
+    for (i = 0; i < best_ic_idx; i++) {
+        probable_key[i] = 'A' + ranked[i * top_k].shift;
+    }
+    probable_key[best_ic_idx] = '\0';
 
     /*Open the output file for writing*/
     if (output_filename == NULL){
@@ -147,10 +129,40 @@ int main(int argc, char *argv[]) {
     /*Write probable key to output file*/
     fprintf(output_file, "Probable key (length %d): %s\n", best_ic_idx, probable_key);
 
+    /*Quadgram fitness of the text deciphered with the probable key*/
+    if (model->quadgram_log != NULL && bytes_read >= 4 && best_ic_idx > 0) {
+        char *plain = malloc(bytes_read + 1);
+        if (plain) {
+            double fitness;
+            vigenere_decipher(buffer, plain, bytes_read, probable_key);
+            fitness = lang_quadgram_score(model->quadgram_log, plain, bytes_read);
+            fprintf(output_file, "Quadgram fitness (%s): %.2f (%.4f per quadgram)\n",
+                    model->name, fitness, fitness / (double)(bytes_read - 3));
+            free(plain);
+        }
+    }
+
+    /*Write the runner-up letters of every position*/
+    if (top_k > 1) {
+        fprintf(output_file, "\nCandidates per key letter (%s):\n",
+                (method == SCORE_CORRELATION) ? "correlation, higher is better" : "chi-squared, lower is better");
+        for (i = 0; i < best_ic_idx; i++) {
+            fprintf(output_file, "%3d:", i + 1);
+            for (int r = 0; r < top_k; r++) {
+                fprintf(output_file, " %c (%.4f)", 'A' + ranked[i * top_k + r].shift, ranked[i * top_k + r].score);
+            }
+            fprintf(output_file, "\n");
+        }
+    }
+
     /* Clean up */
     fclose(output_file);
+    free(ranked);
+    free(profile);
     free(buffer);
-    free(temp);
+    if (model_filename != NULL) {
+        lang_model_close(&loaded);
+    }
 
     return EXIT_SUCCESS;
 
@@ -0,0 +1,207 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "subst.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SUBST_X86 1
+#endif
+
+typedef void (*SUBST_KERNEL)(const char *, char *, size_t, const SUBST_MAP);
+typedef size_t (*SHIFT_KERNEL)(const char *, char *, size_t, const unsigned char *, size_t, size_t);
+
+static void substitute_scalar(const char *input, char *output, size_t length, const SUBST_MAP map){
+    for (size_t i = 0; i < length; i++) {
+        char c = input[i];
+        output[i] = (c >= 'A' && c <= 'Z') ? map[c - 'A'] : c;
+    }
+}
+
+/* Shifts starting at pattern position phase, returns the phase after length
+ * bytes. The phase wraps with a compare instead of a modulo per byte. */
+static size_t shift_scalar(const char *input, char *output, size_t length,
+                           const unsigned char *shift, size_t period, size_t phase){
+    for (size_t i = 0; i < length; i++) {
+        char c = input[i];
+        if (c >= 'A' && c <= 'Z') {
+            int x = (c - 'A') + shift[phase];
+            output[i] = (char)((x >= 26 ? x - 26 : x) + 'A');
+        } else {
+            output[i] = c;
+        }
+        if (++phase == period)
+            phase = 0;
+    }
+    return phase;
+}
+
+#ifdef SUBST_X86
+/* The 26 entries do not fit one 16-byte shuffle, so letters 0..15 are looked
+ * up in the low half of the map and 16..25 in the high half, then blended. */
+__attribute__((target("ssse3,sse4.1")))
+static void substitute_ssse3(const char *input, char *output, size_t length, const SUBST_MAP map){
+    char hi_map[16] = {0};
+    const __m128i lo = _mm_loadu_si128((const __m128i *)map);
+    __m128i hi;
+    const __m128i base = _mm_set1_epi8('A' - 1);
+    const __m128i top = _mm_set1_epi8('Z' + 1);
+    const __m128i fifteen = _mm_set1_epi8(15);
+    const __m128i sixteen = _mm_set1_epi8(16);
+    size_t i = 0;
+
+    memcpy(hi_map, map + 16, 10);
+    hi = _mm_loadu_si128((const __m128i *)hi_map);
+
+    for (; i + 16 <= length; i += 16) {
+        __m128i c = _mm_loadu_si128((const __m128i *)(input + i));
+        __m128i letter = _mm_and_si128(_mm_cmpgt_epi8(c, base), _mm_cmplt_epi8(c, top));
+        __m128i idx = _mm_sub_epi8(c, _mm_set1_epi8('A'));
+        __m128i from_lo = _mm_shuffle_epi8(lo, idx);
+        __m128i from_hi = _mm_shuffle_epi8(hi, _mm_sub_epi8(idx, sixteen));
+        __m128i mapped = _mm_blendv_epi8(from_lo, from_hi, _mm_cmpgt_epi8(idx, fifteen));
+        _mm_storeu_si128((__m128i *)(output + i), _mm_blendv_epi8(c, mapped, letter));
+    }
+    substitute_scalar(input + i, output + i, length - i, map);
+}
+
+/* Add mod 26 as x + s, minus 26 where the sum passed 25; period >= 32 so
+ * one subtraction keeps the phase in range after each vector. */
+__attribute__((target("ssse3,sse4.1")))
+static size_t shift_ssse3(const char *input, char *output, size_t length,
+                          const unsigned char *shift, size_t period, size_t phase){
+    const __m128i base = _mm_set1_epi8('A' - 1);
+    const __m128i top = _mm_set1_epi8('Z' + 1);
+    const __m128i twentyfive = _mm_set1_epi8(25);
+    const __m128i twentysix = _mm_set1_epi8(26);
+    size_t i = 0;
+
+    for (; i + 16 <= length; i += 16) {
+        __m128i c = _mm_loadu_si128((const __m128i *)(input + i));
+        __m128i s = _mm_loadu_si128((const __m128i *)(shift + phase));
+        __m128i letter = _mm_and_si128(_mm_cmpgt_epi8(c, base), _mm_cmplt_epi8(c, top));
+        __m128i x = _mm_add_epi8(_mm_sub_epi8(c, _mm_set1_epi8('A')), s);
+        x = _mm_sub_epi8(x, _mm_and_si128(_mm_cmpgt_epi8(x, twentyfive), twentysix));
+        x = _mm_add_epi8(x, _mm_set1_epi8('A'));
+        _mm_storeu_si128((__m128i *)(output + i), _mm_blendv_epi8(c, x, letter));
+        phase += 16;
+        if (phase >= period)
+            phase -= period;
+    }
+    return shift_scalar(input + i, output + i, length - i, shift, period, phase);
+}
+
+__attribute__((target("avx2")))
+static void substitute_avx2(const char *input, char *output, size_t length, const SUBST_MAP map){
+    char hi_map[16] = {0};
+    __m256i lo, hi;
+    const __m256i base = _mm256_set1_epi8('A' - 1);
+    const __m256i top = _mm256_set1_epi8('Z' + 1);
+    const __m256i fifteen = _mm256_set1_epi8(15);
+    const __m256i sixteen = _mm256_set1_epi8(16);
+    size_t i = 0;
+
+    /* vpshufb looks up within each 128-bit lane, so both lanes hold the map */
+    memcpy(hi_map, map + 16, 10);
+    lo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)map));
+    hi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)hi_map));
+
+    for (; i + 32 <= length; i += 32) {
+        __m256i c = _mm256_loadu_si256((const __m256i *)(input + i));
+        __m256i letter = _mm256_and_si256(_mm256_cmpgt_epi8(c, base), _mm256_cmpgt_epi8(top, c));
+        __m256i idx = _mm256_sub_epi8(c, _mm256_set1_epi8('A'));
+        __m256i from_lo = _mm256_shuffle_epi8(lo, idx);
+        __m256i from_hi = _mm256_shuffle_epi8(hi, _mm256_sub_epi8(idx, sixteen));
+        __m256i mapped = _mm256_blendv_epi8(from_lo, from_hi, _mm256_cmpgt_epi8(idx, fifteen));
+        _mm256_storeu_si256((__m256i *)(output + i), _mm256_blendv_epi8(c, mapped, letter));
+    }
+    substitute_ssse3(input + i, output + i, length - i, map);
+}
+
+__attribute__((target("avx2")))
+static size_t shift_avx2(const char *input, char *output, size_t length,
+                         const unsigned char *shift, size_t period, size_t phase){
+    const __m256i base = _mm256_set1_epi8('A' - 1);
+    const __m256i top = _mm256_set1_epi8('Z' + 1);
+    const __m256i twentyfive = _mm256_set1_epi8(25);
+    const __m256i twentysix = _mm256_set1_epi8(26);
+    size_t i = 0;
+
+    for (; i + 32 <= length; i += 32) {
+        __m256i c = _mm256_loadu_si256((const __m256i *)(input + i));
+        __m256i s = _mm256_loadu_si256((const __m256i *)(shift + phase));
+        __m256i letter = _mm256_and_si256(_mm256_cmpgt_epi8(c, base), _mm256_cmpgt_epi8(top, c));
+        __m256i x = _mm256_add_epi8(_mm256_sub_epi8(c, _mm256_set1_epi8('A')), s);
+        x = _mm256_sub_epi8(x, _mm256_and_si256(_mm256_cmpgt_epi8(x, twentyfive), twentysix));
+        x = _mm256_add_epi8(x, _mm256_set1_epi8('A'));
+        _mm256_storeu_si256((__m256i *)(output + i), _mm256_blendv_epi8(c, x, letter));
+        phase += 32;
+        if (phase >= period)
+            phase -= period;
+    }
+    return shift_ssse3(input + i, output + i, length - i, shift, period, phase);
+}
+#endif
+
+static SUBST_KERNEL kernel = substitute_scalar;
+static SHIFT_KERNEL shift_kernel = shift_scalar;
+static const char *kernel_name = "scalar";
+static pthread_once_t kernel_once = PTHREAD_ONCE_INIT;
+
+static void select_kernel(void){
+#ifdef SUBST_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        kernel = substitute_avx2;
+        shift_kernel = shift_avx2;
+        kernel_name = "avx2";
+    } else if (__builtin_cpu_supports("ssse3") && __builtin_cpu_supports("sse4.1")) {
+        kernel = substitute_ssse3;
+        shift_kernel = shift_ssse3;
+        kernel_name = "ssse3";
+    }
+#endif
+}
+
+void substitute_AZ(const char *input, char *output, size_t length, const SUBST_MAP map){
+    pthread_once(&kernel_once, select_kernel);
+    kernel(input, output, length, map);
+}
+
+int subst_shifts_init(SUBST_SHIFTS *s, const char *key, size_t key_l, int decipher){
+    size_t reps = (32 + key_l - 1) / key_l;
+
+    s->shift = NULL;
+    s->period = 0;
+    if (key_l == 0)
+        return -1;
+    for (size_t j = 0; j < key_l; j++) {
+        if (key[j] < 'A' || key[j] > 'Z')
+            return -1;
+    }
+
+    s->period = key_l * reps;
+    s->shift = malloc(s->period + 32);
+    if (!s->shift)
+        return -1;
+    for (size_t j = 0; j < s->period + 32; j++) {
+        int k = key[j % key_l] - 'A';
+        s->shift[j] = (unsigned char)(decipher ? (26 - k) % 26 : k);
+    }
+    return 0;
+}
+
+void subst_shifts_free(SUBST_SHIFTS *s){
+    free(s->shift);
+    s->shift = NULL;
+}
+
+void shift_AZ(const char *input, char *output, size_t length, const SUBST_SHIFTS *s){
+    pthread_once(&kernel_once, select_kernel);
+    shift_kernel(input, output, length, s->shift, s->period, 0);
+}
+
+const char *substitute_AZ_kernel(void){
+    pthread_once(&kernel_once, select_kernel);
+    return kernel_name;
+}
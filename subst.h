@@ -0,0 +1,35 @@
+#ifndef SUBST_H
+#define SUBST_H
+
+#include <stddef.h>
+
+/* Alphabet map: map[x] is the byte written for the letter 'A' + x */
+typedef char SUBST_MAP[26];
+
+/* Writes input through the map: 'A'..'Z' become map[c - 'A'], any other
+ * byte is copied unchanged. input and output may be the same buffer.
+ * Uses AVX2 or SSSE3 shuffles when the CPU has them, scalar code otherwise. */
+void substitute_AZ(const char *input, char *output, size_t length, const SUBST_MAP map);
+
+/* Repeating shift pattern of a Vigenère key for shift_AZ. The key is
+ * repeated until the period covers a whole vector, and the buffer holds
+ * period + 32 shifts so any 32-byte window starting before period is valid. */
+typedef struct {
+    unsigned char *shift;  /* shift of each text position, 0..25 */
+    size_t period;         /* multiple of the key length, >= 32 */
+} SUBST_SHIFTS;
+
+/* Builds the pattern for key (key_l letters), negated when decipher is set.
+ * Returns -1 if the key has bytes outside 'A'..'Z' or memory runs out. */
+int subst_shifts_init(SUBST_SHIFTS *s, const char *key, size_t key_l, int decipher);
+
+void subst_shifts_free(SUBST_SHIFTS *s);
+
+/* Shifts each 'A'..'Z' at position i by s->shift[i mod period] mod 26, any
+ * other byte is copied unchanged. Same kernel selection as substitute_AZ. */
+void shift_AZ(const char *input, char *output, size_t length, const SUBST_SHIFTS *s);
+
+/* Name of the kernel substitute_AZ and shift_AZ dispatch to ("avx2", "ssse3", "scalar") */
+const char *substitute_AZ_kernel(void);
+
+#endif
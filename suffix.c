@@ -0,0 +1,180 @@
+#include <stdlib.h>
+#include <string.h>
+#include "suffix.h"
+
+/* Stable counting sort of the positions in src by key[pos] (< nkeys) into dst */
+static void radix_pass(const uint32_t *src, uint32_t *dst, size_t length,
+                       const uint32_t *key, uint32_t *count, size_t nkeys){
+    size_t sum = 0;
+
+    memset(count, 0, nkeys * sizeof(uint32_t));
+    for (size_t i = 0; i < length; i++)
+        count[key[src[i]]]++;
+    for (size_t k = 0; k < nkeys; k++) {
+        size_t c = count[k];
+        count[k] = (uint32_t)sum;
+        sum += c;
+    }
+    for (size_t i = 0; i < length; i++)
+        dst[count[key[src[i]]]++] = src[i];
+}
+
+uint32_t *suffix_array(const char *text, size_t length){
+    size_t nkeys = (length > 256) ? length : 256;
+    uint32_t *sa = malloc((length + 1) * sizeof(uint32_t));
+    uint32_t *rank = malloc((length + 1) * sizeof(uint32_t));
+    uint32_t *tmp = malloc((length + 1) * sizeof(uint32_t));
+    uint32_t *count = malloc(nkeys * sizeof(uint32_t));
+
+    if (!sa || !rank || !tmp || !count) {
+        free(sa);
+        free(rank);
+        free(tmp);
+        free(count);
+        return NULL;
+    }
+
+    /* Round 0: suffixes sorted by their first character */
+    {
+        size_t sum = 0;
+
+        memset(count, 0, 256 * sizeof(uint32_t));
+        for (size_t i = 0; i < length; i++) {
+            rank[i] = (unsigned char)text[i];
+            count[rank[i]]++;
+        }
+        for (size_t c = 0; c < 256; c++) {
+            size_t n = count[c];
+            count[c] = (uint32_t)sum;
+            sum += n;
+        }
+        for (size_t i = 0; i < length; i++)
+            sa[count[rank[i]]++] = (uint32_t)i;
+    }
+
+    /* Ranks by the first 2k characters from the ranks by the first k */
+    for (size_t k = 1; k < length; k <<= 1) {
+        size_t p = 0;
+        uint32_t classes;
+
+        /* By second half: suffixes shorter than k first, then sa order */
+        for (size_t i = length - k; i < length; i++)
+            tmp[p++] = (uint32_t)i;
+        for (size_t j = 0; j < length; j++) {
+            if (sa[j] >= k)
+                tmp[p++] = sa[j] - (uint32_t)k;
+        }
+        /* Then stably by first half */
+        radix_pass(tmp, sa, length, rank, count, nkeys);
+
+        /* New ranks: equal pairs share a class */
+        tmp[sa[0]] = 0;
+        classes = 1;
+        for (size_t j = 1; j < length; j++) {
+            uint32_t a = sa[j - 1], b = sa[j];
+            int same = rank[a] == rank[b]
+                    && (a + k < length) == (b + k < length)
+                    && (a + k >= length || rank[a + k] == rank[b + k]);
+            if (!same)
+                classes++;
+            tmp[b] = classes - 1;
+        }
+        memcpy(rank, tmp, length * sizeof(uint32_t));
+        if (classes == length)
+            break;
+    }
+
+    free(rank);
+    free(tmp);
+    free(count);
+    return sa;
+}
+
+uint32_t *lcp_array(const char *text, size_t length, const uint32_t *sa){
+    uint32_t *lcp = malloc((length + 1) * sizeof(uint32_t));
+    uint32_t *rank = malloc((length + 1) * sizeof(uint32_t));
+    size_t h = 0;
+
+    if (!lcp || !rank) {
+        free(lcp);
+        free(rank);
+        return NULL;
+    }
+
+    for (size_t k = 0; k < length; k++)
+        rank[sa[k]] = (uint32_t)k;
+    if (length > 0)
+        lcp[0] = 0;
+
+    /* Suffixes in text order: the LCP drops by at most one per step */
+    for (size_t i = 0; i < length; i++) {
+        if (rank[i] > 0) {
+            size_t j = sa[rank[i] - 1];
+            while (i + h < length && j + h < length && text[i + h] == text[j + h])
+                h++;
+            lcp[rank[i]] = (uint32_t)h;
+            if (h > 0)
+                h--;
+        } else {
+            h = 0;
+        }
+    }
+
+    free(rank);
+    return lcp;
+}
+
+static int cmp_u32(const void *a, const void *b){
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* Hands sa[lb..rb] to fn as a sorted position list */
+static void report(const uint32_t *sa, size_t lb, size_t rb, size_t len, uint32_t *scratch,
+                   SUFFIX_REPEAT_FN fn, void *arg){
+    size_t count = rb - lb + 1;
+
+    memcpy(scratch, sa + lb, count * sizeof(uint32_t));
+    qsort(scratch, count, sizeof(uint32_t), cmp_u32);
+    fn(scratch, count, len, arg);
+}
+
+int suffix_repeats(const uint32_t *sa, const uint32_t *lcp, size_t length, size_t min_len,
+                   SUFFIX_REPEAT_FN fn, void *arg){
+    uint32_t *scratch = malloc((length + 1) * sizeof(uint32_t));
+    uint32_t *stack_lcp = malloc((length + 1) * sizeof(uint32_t));
+    uint32_t *stack_lb = malloc((length + 1) * sizeof(uint32_t));
+    size_t top = 0;
+
+    if (!scratch || !stack_lcp || !stack_lb) {
+        free(scratch);
+        free(stack_lcp);
+        free(stack_lb);
+        return -1;
+    }
+
+    /* Bottom-up traversal of the lcp-interval tree */
+    stack_lcp[0] = 0;
+    stack_lb[0] = 0;
+    for (size_t k = 1; k <= length; k++) {
+        uint32_t cur = (k < length) ? lcp[k] : 0;
+        size_t lb = k - 1;
+
+        while (cur < stack_lcp[top]) {
+            lb = stack_lb[top];
+            if (stack_lcp[top] >= min_len)
+                report(sa, lb, k - 1, stack_lcp[top], scratch, fn, arg);
+            top--;
+        }
+        if (cur > stack_lcp[top]) {
+            top++;
+            stack_lcp[top] = cur;
+            stack_lb[top] = (uint32_t)lb;
+        }
+    }
+
+    free(scratch);
+    free(stack_lcp);
+    free(stack_lb);
+    return 0;
+}
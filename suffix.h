@@ -0,0 +1,29 @@
+#ifndef SUFFIX_H
+#define SUFFIX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Called for each repeated substring: len characters starting at each of
+ * the count (>= 2) positions in pos, which are sorted in increasing order.
+ * pos is only valid during the call. */
+typedef void (*SUFFIX_REPEAT_FN)(const uint32_t *pos, size_t count, size_t len, void *arg);
+
+/* Suffix array of text[0..length) by prefix doubling with radix sorts:
+ * sa[k] is the start of the k-th smallest suffix. length must be below
+ * 2^32. Returns a malloc'd array, or NULL if memory runs out. */
+uint32_t *suffix_array(const char *text, size_t length);
+
+/* LCP array by Kasai's algorithm: lcp[k] is the length of the longest
+ * common prefix of suffixes sa[k-1] and sa[k], lcp[0] = 0. Returns a
+ * malloc'd array, or NULL if memory runs out. */
+uint32_t *lcp_array(const char *text, size_t length, const uint32_t *sa);
+
+/* Reports every lcp-interval whose common prefix has at least min_len
+ * characters: each right-maximal repeat (a repeat that cannot be extended
+ * to the right at all its occurrences) of length >= min_len, with all of
+ * its occurrences. Returns 0, or -1 if memory runs out. */
+int suffix_repeats(const uint32_t *sa, const uint32_t *lcp, size_t length, size_t min_len,
+                   SUFFIX_REPEAT_FN fn, void *arg);
+
+#endif
@@ -1,5 +1,8 @@
 #include "utils.h"
 #include "lfsr.h"
+#include <pthread.h>
+#include <math.h>
+#include <errno.h>
 void euclides(mpz_t a , mpz_t b, mpz_t res) {
 
     mpz_t r0, r1, r2, q;
@@ -95,76 +98,114 @@ void inverse_mod(mpz_t a, mpz_t mod, mpz_t a_inv) {
     mpz_clears(gcd, x, y, NULL);
 }
 
-void affine_cipher(const char *input, char *output, size_t length, mpz_t a, mpz_t b, mpz_t mod){
+/* Builds the alphabet map of the affine cipher: E(x) = (a*x + b) mod m
+ * (or D(y) = a⁻¹ * (y - b) mod m) for the 26 letters. Only the table needs
+ * GMP, the text is then mapped by substitute_AZ. */
+static void affine_table(SUBST_MAP table, mpz_t a, mpz_t b, mpz_t mod, int decipher){
 
-    mpz_t x, y;
-    mpz_inits(x, y, NULL);
+    mpz_t a_inv, x, y;
+    mpz_inits(a_inv, x, y, NULL);
 
-    for (size_t i = 0; i < length; i++) {
-        char c = input[i];
-        /*If the character is the the correct range*/
-        if (c >= 'A' && c <= 'Z') {
-            int x_int = c - 'A';
-            mpz_set_ui(x, x_int);
+    if (decipher) {
+        inverse_mod(a, mod, a_inv);
+    }
+
+    for (int c = 'A'; c <= 'Z'; c++) {
+        if (!decipher) {
+            mpz_set_ui(x, c - 'A');
             /*Apply affine transformation*/
             mpz_mul(y, a, x); // a * x
             mpz_add(y, y, b); // a * x + b
             mpz_mod(y, y, mod); // mod
-            output[i] = (char)(mpz_get_ui(y) + 'A');
+            table[c - 'A'] = (char)(mpz_get_ui(y) + 'A');
         } else {
-            output[i] = c;
+            mpz_set_ui(y, c - 'A');
+            /*Apply inverse affine transformation*/
+            mpz_sub(y, y, b); // y - b
+            mpz_mod(y, y, mod); // mod
+            mpz_mul(x, a_inv, y); // a_inv * (y - b)
+            mpz_mod(x, x, mod); // mod
+            table[c - 'A'] = (char)(mpz_get_ui(x) + 'A');
         }
     }
+
+    mpz_clears(a_inv, x, y, NULL);
+}
+
+void affine_cipher(const char *input, char *output, size_t length, mpz_t a, mpz_t b, mpz_t mod){
+
+    SUBST_MAP table;
+    affine_table(table, a, b, mod, 0);
+
+    substitute_AZ(input, output, length, table);
     output[length] = '\0';
-    mpz_clears(x, y, NULL);
   
 }
 
 void affine_decipher(const char *input, char *output, size_t length, mpz_t a, mpz_t b, mpz_t mod){
 
-    mpz_t a_inv, x, y;
-    mpz_inits(a_inv, x, y, NULL);
-
-    inverse_mod(a, mod, a_inv);
+    SUBST_MAP table;
+    affine_table(table, a, b, mod, 1);
 
-    for (size_t i = 0; i < length; i++) {
-        char c = input[i];
-        /*If the character is the the correct range*/
-        if (c >= 'A' && c <= 'Z') {
-            int y_int = c - 'A';
-            mpz_set_ui(y, y_int);
-            /*Apply inverse affine transformation*/
-            mpz_sub(y, y, b); // y - b
-            mpz_mod(y, y, mod); // mod
-            mpz_mul(x, a_inv, y); // a_inv * (y - b)
-            mpz_mod(x, x, mod); // mod
-            output[i] = (char)(mpz_get_ui(x) + 'A');
-        } else {
-            output[i] = c;
-        }
-    }
+    substitute_AZ(input, output, length, table);
     output[length] = '\0';
-    mpz_clears(a_inv, x, y, NULL);
   
 }
 
 
 
 void determinant(mpz_t **matrix, int n, mpz_t det_out) {
-    mpz_t det;
-    mpz_init(det);
-
-    if (n == 2){
-        mpz_t term1, term2;
-        mpz_inits(term1, term2, NULL);
-        mpz_mul(term1, matrix[0][0], matrix[1][1]);
-        mpz_mul(term2, matrix[0][1], matrix[1][0]);
-        mpz_sub(det, term1, term2);
-        mpz_clears(term1, term2, NULL);
-        mpz_set(det_out, det);
-        return;
+    mpz_t *m = malloc((size_t)n * n * sizeof(mpz_t));
+    mpz_t prev, t;
+    int sign = 1;
+
+    /* Bareiss: every division below is exact, so the entries stay integers
+     * no larger than the minors of the matrix */
+    mpz_inits(prev, t, NULL);
+    mpz_set_ui(prev, 1);
+    for (int i = 0; i < n * n; i++) {
+        mpz_init_set(m[i], matrix[i / n][i % n]);
+    }
+
+    for (int k = 0; k < n - 1; k++) {
+        if (mpz_sgn(m[k * n + k]) == 0) {
+            int r = k + 1;
+            while (r < n && mpz_sgn(m[r * n + k]) == 0) {
+                r++;
+            }
+            if (r == n) {
+                mpz_set_ui(m[(n - 1) * n + n - 1], 0);
+                break;
+            }
+            for (int j = k; j < n; j++) {
+                mpz_swap(m[k * n + j], m[r * n + j]);
+            }
+            sign = -sign;
+        }
+        for (int i = k + 1; i < n; i++) {
+            for (int j = k + 1; j < n; j++) {
+                mpz_mul(t, m[i * n + j], m[k * n + k]);
+                mpz_submul(t, m[i * n + k], m[k * n + j]);
+                mpz_divexact(m[i * n + j], t, prev);
+            }
+        }
+        mpz_set(prev, m[k * n + k]);
     }
-    return;
+
+    if (n > 0) {
+        mpz_set(det_out, m[(n - 1) * n + n - 1]);
+        if (sign < 0) {
+            mpz_neg(det_out, det_out);
+        }
+    } else {
+        mpz_set_ui(det_out, 1);
+    }
+
+    for (int i = 0; i < n * n; i++) {
+        mpz_clear(m[i]);
+    }
+    free(m);
+    mpz_clears(prev, t, NULL);
 }
 
 void matrix_mul(mpz_t *result, mpz_t **A, mpz_t *x, int n, mpz_t mod) {
@@ -187,14 +228,41 @@ void matrix_mul(mpz_t *result, mpz_t **A, mpz_t *x, int n, mpz_t mod) {
 }
 
 
+/* Copies A (n x n) and b reduced mod m into one native array: A then b */
+static uint32_t *hill_key_native(mpz_t **A, mpz_t *b, int n, uint32_t m) {
+    uint32_t *key = malloc(((size_t)n * n + n) * sizeof(uint32_t));
+
+    if (!key)
+        return NULL;
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            key[i * n + j] = (uint32_t)mpz_fdiv_ui(A[i][j], m);
+        }
+        key[n * n + i] = (uint32_t)mpz_fdiv_ui(b[i], m);
+    }
+    return key;
+}
+
 void affine_cipher_hill(const char *input, char *output, size_t length, mpz_t **A, mpz_t *b, int n, mpz_t mod) {
 
+    /*Word-sized moduli go through the native blocked engine*/
+    if (mpz_sgn(mod) > 0 && mpz_cmp_ui(mod, HILL_MAX_MOD) < 0) {
+        uint32_t m = (uint32_t)mpz_get_ui(mod);
+        uint32_t *key = hill_key_native(A, b, n, m);
+        /*Out of memory for the engine: the GMP path below*/
+        if (key && hill_affine_AZ(input, output, length, key, key + (size_t)n * n, n, m) == 0) {
+            free(key);
+            return;
+        }
+        free(key);
+    }
 
     /*Initialize vectors x and y*/
     mpz_t *x = malloc(n * sizeof(mpz_t));
     mpz_t *y = malloc(n * sizeof(mpz_t));
-    int mask[length];
-    char special_chars[length];
+    /* Non-letters of the current block only */
+    int *mask = malloc(n * sizeof(int));
+    char *special_chars = malloc(n);
     for (int i = 0; i < n; i++) {
         mpz_init(x[i]);
         mpz_init(y[i]);
@@ -210,10 +278,10 @@ void affine_cipher_hill(const char *input, char *output, size_t length, mpz_t **
                 if (c >= 'A' && c <= 'Z') {
                     int x_int = c - 'A';
                     mpz_set_ui(x[j], x_int);
-                    mask[i + j] = 0;
+                    mask[j] = 0;
                 } else {
-                    mask[i + j] = 1;
-                    special_chars[i + j] = c;
+                    mask[j] = 1;
+                    special_chars[j] = c;
                     mpz_set_ui(x[j], 0); 
                 }
             } else {
@@ -231,8 +299,8 @@ void affine_cipher_hill(const char *input, char *output, size_t length, mpz_t **
         /* Write the output block */
         for (int j = 0; j < n; j++) {
             if (i + j < length) {
-                if(mask[i + j] == 1){
-                    output[i + j] = special_chars[i + j];
+                if(mask[j] == 1){
+                    output[i + j] = special_chars[j];
                 }else{
                     output[i + j] = (char)(mpz_get_ui(y[j]) + 'A');
                 }
@@ -247,44 +315,122 @@ void affine_cipher_hill(const char *input, char *output, size_t length, mpz_t **
     }
     free(x);
     free(y);
+    free(mask);
+    free(special_chars);
 }
 
 
-void inverse_matrix(mpz_t **matrix, mpz_t **inv_matrix, int n, mpz_t mod) {
-    if (n == 2) {
-        mpz_t det, det_inv;
-        mpz_inits(det, det_inv, NULL);
-        /*Calculate determinant and its inverse modulo mod*/
-        determinant(matrix, n, det);
-        inverse_mod(det, mod, det_inv);
-        mpz_t temp;
-        mpz_init(temp);
-
-        /*Calculate inverse matrix using formula for 2x2 matrix*/
-        mpz_mul(temp, matrix[1][1], det_inv);
-        mpz_mod(inv_matrix[0][0], temp, mod);
-
-        mpz_mul(temp, matrix[0][1], det_inv);
-        mpz_neg(temp, temp);
-        mpz_mod(inv_matrix[0][1], temp, mod);
+/* Inverse for moduli too large for the native routines: adj(A) / det(A),
+ * every cofactor a Bareiss determinant. Zero matrix without inverse. */
+static void inverse_matrix_mpz(mpz_t **matrix, mpz_t **inv_matrix, int n, mpz_t mod) {
+    int k = (n > 1) ? n - 1 : 1;
+    mpz_t det, det_inv, cof;
+    mpz_t *cells = malloc((size_t)k * k * sizeof(mpz_t));
+    mpz_t **minor = malloc(k * sizeof(mpz_t *));
+    int ok;
+
+    mpz_inits(det, det_inv, cof, NULL);
+    determinant(matrix, n, det);
+    mpz_mod(det, det, mod);
+    ok = (cells && minor && mpz_invert(det_inv, det, mod) != 0);
+    for (int r = 0; ok && r < k * k; r++) {
+        mpz_init(cells[r]);
+    }
 
-        mpz_mul(temp, matrix[1][0], det_inv);
-        mpz_neg(temp, temp);
-        mpz_mod(inv_matrix[1][0], temp, mod);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            if (!ok) {
+                mpz_set_ui(inv_matrix[i][j], 0);
+                continue;
+            }
+            /* Cofactor (j, i): drop row j and column i */
+            mpz_set_ui(cof, 1);
+            if (n > 1) {
+                for (int r = 0, mr = 0; r < n; r++) {
+                    if (r == j) continue;
+                    minor[mr] = cells + (size_t)mr * k;
+                    for (int c = 0, mc = 0; c < n; c++) {
+                        if (c == i) continue;
+                        mpz_set(minor[mr][mc++], matrix[r][c]);
+                    }
+                    mr++;
+                }
+                determinant(minor, k, cof);
+            }
+            if ((i + j) % 2) {
+                mpz_neg(cof, cof);
+            }
+            mpz_mul(cof, cof, det_inv);
+            mpz_mod(inv_matrix[i][j], cof, mod);
+        }
+    }
 
-        mpz_mul(temp, matrix[0][0], det_inv);
-        mpz_mod(inv_matrix[1][1], temp, mod);
+    for (int r = 0; ok && r < k * k; r++) {
+        mpz_clear(cells[r]);
+    }
+    free(cells);
+    free(minor);
+    mpz_clears(det, det_inv, cof, NULL);
+}
 
-        mpz_clear(det);
-        mpz_clear(det_inv);
-        mpz_clear(temp);
+void inverse_matrix(mpz_t **matrix, mpz_t **inv_matrix, int n, mpz_t mod) {
+    if (mpz_cmp_ui(mod, HILL_MAX_MOD) >= 0) {
+        inverse_matrix_mpz(matrix, inv_matrix, n, mod);
+        return;
     }
 
+    uint32_t m = (uint32_t)mpz_get_ui(mod);
+    uint32_t *a = calloc((size_t)n * n, sizeof(uint32_t));
+    uint32_t *inv = calloc((size_t)n * n, sizeof(uint32_t));
 
+    /* Row reduction on native integers; a singular key gives the zero matrix */
+    if (a && inv) {
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) {
+                a[i * n + j] = (uint32_t)mpz_fdiv_ui(matrix[i][j], m);
+            }
+        }
+        if (hill_inverse_mod(a, inv, n, m) != 0) {
+            memset(inv, 0, (size_t)n * n * sizeof(uint32_t));
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            mpz_set_ui(inv_matrix[i][j], (a && inv) ? inv[i * n + j] : 0);
+        }
+    }
+    free(a);
+    free(inv);
 }
 
 void affine_decipher_hill(const char *input, char *output, size_t length, mpz_t **A, mpz_t *b, int n, mpz_t mod) {
-    
+
+    /*Word-sized moduli: x = A_inv * y - A_inv * b through the native engine*/
+    if (mpz_sgn(mod) > 0 && mpz_cmp_ui(mod, HILL_MAX_MOD) < 0) {
+        uint32_t m = (uint32_t)mpz_get_ui(mod);
+        uint32_t *key = hill_key_native(A, b, n, m);
+        uint32_t *inv = malloc(((size_t)n * n + n) * sizeof(uint32_t));
+        if (key && inv) {
+            /*A key without inverse leaves the zero matrix, as inverse_matrix does*/
+            hill_inverse_mod(key, inv, n, m);
+            for (int i = 0; i < n; i++) {
+                uint64_t s = 0;
+                for (int k = 0; k < n; k++) {
+                    s = (s + (uint64_t)inv[i * n + k] * key[n * n + k]) % m;
+                }
+                inv[n * n + i] = (uint32_t)((m - s) % m);
+            }
+            /*Out of memory for the engine: the GMP path below*/
+            if (hill_affine_AZ(input, output, length, inv, inv + (size_t)n * n, n, m) == 0) {
+                free(key);
+                free(inv);
+                return;
+            }
+        }
+        free(key);
+        free(inv);
+    }
+
     /*Compute inverse matrix of A*/
     mpz_t **A_inv = malloc(n * sizeof(mpz_t *));
     for (int i = 0; i < n; i++) {
@@ -303,8 +449,9 @@ void affine_decipher_hill(const char *input, char *output, size_t length, mpz_t
         mpz_init(y[i]);
     }
 
-    int mask[length];
-    char special_chars[length];
+    /* Non-letters of the current block only */
+    int *mask = malloc(n * sizeof(int));
+    char *special_chars = malloc(n);
 
     /*Process the input in blocks of size n*/
     for (size_t i = 0; i < length; i += n){
@@ -316,11 +463,11 @@ void affine_decipher_hill(const char *input, char *output, size_t length, mpz_t
                 if (c >= 'A' && c <= 'Z') {
                     int y_int = c - 'A';
                     mpz_set_ui(y[j], y_int);
-                    mask[i + j] = 0;
+                    mask[j] = 0;
                 } else {
                     mpz_set_ui(y[j], 0);
-                    mask[i + j] = 1;
-                    special_chars[i + j] = c;
+                    mask[j] = 1;
+                    special_chars[j] = c;
 
                 }
             } else {
@@ -338,8 +485,8 @@ void affine_decipher_hill(const char *input, char *output, size_t length, mpz_t
         /* Write the output block */
         for (int j = 0; j < n; j++) {
             if (i + j < length) {
-                if(mask[i + j] == 1){
-                    output[i + j] = special_chars[i + j];
+                if(mask[j] == 1){
+                    output[i + j] = special_chars[j];
                 }else{
                     output[i + j] = (char)(mpz_get_ui(x[j]) + 'A');
                 }
@@ -355,6 +502,8 @@ void affine_decipher_hill(const char *input, char *output, size_t length, mpz_t
 
     free(x);
     free(y);
+    free(mask);
+    free(special_chars);
     for (int i = 0; i < n; i++) {
         for (int j = 0; j < n; j++) {
             mpz_clear(A_inv[i][j]);
@@ -364,11 +513,168 @@ void affine_decipher_hill(const char *input, char *output, size_t length, mpz_t
     free(A_inv);
 }
 
+/* Letters of the padding header: one per base-26 digit of n-1 */
+static int hill_header_letters(int n) {
+    int header = 1;
+
+    for (int p = (n - 1) / 26; p > 0; p /= 26) {
+        header++;
+    }
+    return header;
+}
+
+/* Applies the key to length letters, natively when the key was converted
+ * and the engine has memory */
+static void hill_stream_apply(const char *in, char *out, size_t length, const uint32_t *key,
+                              mpz_t **A, mpz_t *b, int n, mpz_t mod, int cipher) {
+    if (key && hill_affine_AZ(in, out, length, key, key + (size_t)n * n, n, (uint32_t)mpz_get_ui(mod)) == 0) {
+        return;
+    }
+    if (cipher) {
+        affine_cipher_hill(in, out, length, A, b, n, mod);
+    } else {
+        affine_decipher_hill(in, out, length, A, b, n, mod);
+    }
+}
+
+int affine_hill_stream(FILE *in, FILE *out, mpz_t **A, mpz_t *b, int n, mpz_t mod, int cipher) {
+    int header = hill_header_letters(n);
+    /* Carried letters: a partial block, plus when deciphering the last
+     * block and the header, which are only known at EOF */
+    size_t carry_max = (size_t)2 * n + header;
+    char *text = malloc(HILL_STREAM_CHUNK + carry_max + 1);
+    char *res = malloc(HILL_STREAM_CHUNK + carry_max + 1);
+    uint32_t *key = NULL;
+    size_t len = 0;
+    int padding = 0, done = 0, status = 0;
+
+    if (!text || !res) {
+        free(text);
+        free(res);
+        return -1;
+    }
+
+    /* One native key for the whole stream: (A, b), or (A^-1, -A^-1 b) */
+    if (mpz_sgn(mod) > 0 && mpz_cmp_ui(mod, HILL_MAX_MOD) < 0) {
+        uint32_t m = (uint32_t)mpz_get_ui(mod);
+        uint32_t *plain = hill_key_native(A, b, n, m);
+
+        if (plain && !cipher) {
+            key = malloc(((size_t)n * n + n) * sizeof(uint32_t));
+            if (key) {
+                hill_inverse_mod(plain, key, n, m);
+                for (int i = 0; i < n; i++) {
+                    uint64_t s = 0;
+                    for (int k = 0; k < n; k++) {
+                        s = (s + (uint64_t)key[i * n + k] * plain[n * n + k]) % m;
+                    }
+                    key[n * n + i] = (uint32_t)((m - s) % m);
+                }
+            }
+            free(plain);
+        } else {
+            key = plain;
+        }
+    }
+
+    while (!done) {
+        size_t got = fread(text + len, 1, HILL_STREAM_CHUNK, in);
+        char *nul;
+        size_t ready;
+
+        if (got == 0) {
+            if (ferror(in)) {
+                status = -1;
+            }
+            break;
+        }
+        /* The in-memory version stops at the first NUL byte */
+        if ((nul = memchr(text + len, '\0', got)) != NULL) {
+            got = nul - (text + len);
+            done = 1;
+        }
+        text[len + got] = '\0';
+        len += got - normalize_AZ(text + len, got, text + len);
+
+        /* Whole blocks that cannot belong to the tail */
+        if (cipher) {
+            ready = len - len % n;
+        } else {
+            ready = (len > (size_t)n + header) ? (len - n - header) / n * n : 0;
+        }
+        if (ready > 0) {
+            hill_stream_apply(text, res, ready, key, A, b, n, mod, cipher);
+            if (fwrite(res, 1, ready, out) != ready) {
+                status = -1;
+                break;
+            }
+            memmove(text, text + ready, len - ready);
+            len -= ready;
+        }
+    }
+
+    if (status == 0 && cipher) {
+        /*Pad the last block and append the header*/
+        padding = (n - (len % n)) % n;
+        memset(text + len, 'A' + (padding % 26), padding);
+        len += padding;
+        hill_stream_apply(text, res, len, key, A, b, n, mod, cipher);
+        for (int i = header - 1, p = padding; i >= 0; i--, p /= 26) {
+            res[len + i] = 'A' + (p % 26);
+        }
+        if (fwrite(res, 1, len + header, out) != len + header) {
+            status = -1;
+        }
+    } else if (status == 0) {
+        /*Read the padding from the header and drop it from the last block*/
+        if (len < (size_t)header) {
+            errno = EINVAL;
+            status = -1;
+        } else {
+            for (int i = 0; i < header; i++) {
+                padding = padding * 26 + (text[len - header + i] - 'A');
+            }
+            len -= header;
+            hill_stream_apply(text, res, len, key, A, b, n, mod, cipher);
+            len = ((size_t)padding < len) ? len - padding : 0;
+            if (fwrite(res, 1, len, out) != len) {
+                status = -1;
+            }
+        }
+    }
+
+    free(key);
+    free(text);
+    free(res);
+    return status;
+}
+
 void vigenere_cipher(const char *input, char *output, size_t length, const char *key){
 
     size_t key_l = strlen(key);
     char c, k;
     int c_ciphered;
+    SUBST_SHIFTS shifts;
+
+    /* A one-letter key is a plain substitution */
+    if (key_l == 1) {
+        SUBST_MAP table;
+        for (int x = 0; x < 26; x++) {
+            table[x] = (char)((x + (key[0] - 'A')) % 26 + 'A');
+        }
+        substitute_AZ(input, output, length, table);
+        output[length] = '\0';
+        return;
+    }
+
+    /* Keys of capital letters go through the vectorized shift kernel,
+     * anything else keeps the per-character formula */
+    if (subst_shifts_init(&shifts, key, key_l, 0) == 0) {
+        shift_AZ(input, output, length, &shifts);
+        subst_shifts_free(&shifts);
+        output[length] = '\0';
+        return;
+    }
 
     for (size_t i = 0; i < length; i++) {
         c = input[i];
@@ -389,6 +695,24 @@ void vigenere_decipher(const char *input, char *output, size_t length, const cha
     size_t key_l = strlen(key);
     char c, k;
     int c_deciphered;
+    SUBST_SHIFTS shifts;
+
+    if (key_l == 1) {
+        SUBST_MAP table;
+        for (int x = 0; x < 26; x++) {
+            table[x] = (char)((x - (key[0] - 'A') + 26) % 26 + 'A');
+        }
+        substitute_AZ(input, output, length, table);
+        output[length] = '\0';
+        return;
+    }
+
+    if (subst_shifts_init(&shifts, key, key_l, 1) == 0) {
+        shift_AZ(input, output, length, &shifts);
+        subst_shifts_free(&shifts);
+        output[length] = '\0';
+        return;
+    }
 
     for (size_t i = 0; i < length; i++) {
         c = input[i];
@@ -419,65 +743,208 @@ int normalize_AZ(char *buffer, size_t length, char *text) {
     return purged;
 }
 
-double calculate_ic(const char *buffer, size_t length, int n) {
-    char **cols;
-    int i, j, col_index;
-    double ic_total = 0.0;
-    int freq[n][26];
+char *read_text_AZ(const char *filename, size_t *length) {
+    FILE *in = stdin;
+    size_t size = 0, capacity = 1 << 16;
+    char *text = malloc(capacity);
+    size_t got;
 
-    cols = malloc(n * sizeof(char *));
-    for (i = 0; i < n; i++) {
-        cols[i] = malloc((((length + n - 1) / n ) + 1) * sizeof(char)); /* ceil(lentgh/n) */
+    if (filename != NULL && (in = fopen(filename, "rb")) == NULL) {
+        free(text);
+        return NULL;
+    }
+    if (!text) {
+        if (in != stdin)
+            fclose(in);
+        return NULL;
     }
 
-    /*Initialize frequency array*/
-    for (i = 0; i < n; i++) {
-        for (j = 0; j < 26; j++) {
-            freq[i][j] = 0;
+    /* Bloques hasta EOF, dejando sitio para el '\0' */
+    while ((got = fread(text + size, 1, capacity - size - 1, in)) > 0) {
+        size += got;
+        if (size + 1 == capacity) {
+            char *grown = realloc(text, capacity * 2);
+            if (!grown) {
+                free(text);
+                if (in != stdin)
+                    fclose(in);
+                return NULL;
+            }
+            text = grown;
+            capacity *= 2;
         }
     }
+    if (ferror(in)) {
+        free(text);
+        if (in != stdin)
+            fclose(in);
+        errno = EIO;
+        return NULL;
+    }
+    if (in != stdin)
+        fclose(in);
+    text[size] = '\0';
+
+    /* The normalized text is never longer, so it overwrites the raw bytes */
+    normalize_AZ(text, size, text);
+    *length = strlen(text);
+    return text;
+}
 
-    for (i = 0, col_index = 0; i < length; i++) {
-        cols[i%n][col_index] = buffer[i];
-        freq[i%n][buffer[i] - 'A']++;
-        if ((i+1) % n == 0) {
-            col_index++;
-        }
+int gcd_aux(int a, int b) {
+    while (b != 0) {
+        int temp = b;
+        b = a % b;
+        a = temp;
     }
+    return a;
+}
 
-    for (i = 0; i < n; i++) {
-        if (i < length % n) {
-            cols[i][col_index] = '\0';
-        } else {
-            cols[i][col_index - 1] = '\0';
+/* Growable list of raw distances filled from the repeated n-gram lists */
+typedef struct {
+    uint32_t *dist;
+    size_t size;
+    size_t capacity;
+    int failed;
+} DISTANCE_LIST;
+
+static void collect_distances(const uint32_t *pos, size_t count, size_t len, void *arg) {
+    DISTANCE_LIST *list = arg;
+
+    (void)len;
+    if (list->size + count > list->capacity) {
+        size_t capacity = list->capacity ? list->capacity : 1024;
+        uint32_t *dist;
+
+        while (capacity < list->size + count)
+            capacity *= 2;
+        dist = realloc(list->dist, capacity * sizeof(uint32_t));
+        if (!dist) {
+            list->failed = 1;
+            return;
         }
+        list->dist = dist;
+        list->capacity = capacity;
     }
+    for (size_t k = 1; k < count; k++)
+        list->dist[list->size++] = pos[k] - pos[k - 1];
+}
 
-    for (i = 0; i < n; i++){
-        size_t col_length = strlen(cols[i]);
-        double ic_col = 0.0;
-        for (j = 0; j < 26; j++) { /*For each letter A-Z (26 letters)*/
-            ic_col += freq[i][j] * (freq[i][j] - 1);
+/* LSD radix sort of 32-bit values, 11 bits per pass; tmp holds n values.
+ * Passes over bits above the largest value are skipped. */
+static void radix_sort_u32(uint32_t *v, uint32_t *tmp, size_t n) {
+    uint32_t *src = v, *dst = tmp;
+    uint32_t max = 0;
+    size_t count[2048];
+
+    for (size_t i = 0; i < n; i++)
+        if (v[i] > max)
+            max = v[i];
+
+    for (int shift = 0; shift < 32 && (max >> shift) != 0; shift += 11) {
+        size_t sum = 0;
+        uint32_t *swap;
+
+        memset(count, 0, sizeof(count));
+        for (size_t i = 0; i < n; i++)
+            count[(src[i] >> shift) & 2047]++;
+        for (int k = 0; k < 2048; k++) {
+            size_t c = count[k];
+            count[k] = sum;
+            sum += c;
         }
-        ic_col /= (col_length * (col_length - 1));
-        ic_total += ic_col;
+        for (size_t i = 0; i < n; i++)
+            dst[count[(src[i] >> shift) & 2047]++] = src[i];
+        swap = src;
+        src = dst;
+        dst = swap;
     }
+    if (src != v)
+        memcpy(v, src, n * sizeof(uint32_t));
+}
 
-    for (i = 0; i < n; i++) {
-        free(cols[i]);
+int kasiski_distances(const char *text, size_t length, int ngram, KASISKI_DISTANCES *d) {
+    DISTANCE_LIST list = { NULL, 0, 0, 0 };
+    NGRAM_INDEX idx;
+
+    d->value = NULL;
+    d->count = NULL;
+    d->size = 0;
+    d->total = 0;
+
+    if (ngram_index_build(&idx, text, length, ngram, 2) != 0)
+        return -1;
+    ngram_index_foreach(&idx, collect_distances, &list);
+    ngram_index_free(&idx);
+    if (list.failed) {
+        free(list.dist);
+        return -1;
     }
-    free(cols);
 
-    return ic_total / n;
+    /* Sorted, the raw list compresses in place into (value, count) runs;
+     * the count array doubles as the radix sort buffer */
+    d->count = malloc((list.size + 1) * sizeof(uint32_t));
+    if (!d->count) {
+        free(list.dist);
+        return -1;
+    }
+    radix_sort_u32(list.dist, d->count, list.size);
+    for (size_t i = 0; i < list.size; i++) {
+        if (d->size > 0 && list.dist[d->size - 1] == list.dist[i]) {
+            d->count[d->size - 1]++;
+        } else {
+            list.dist[d->size] = list.dist[i];
+            d->count[d->size++] = 1;
+        }
+    }
+    d->total = list.size;
+    d->value = list.dist;
+    return 0;
 }
 
-int gcd_aux(int a, int b) {
-    while (b != 0) {
-        int temp = b;
-        b = a % b;
-        a = temp;
+void kasiski_distances_free(KASISKI_DISTANCES *d) {
+    free(d->value);
+    free(d->count);
+    d->value = NULL;
+    d->count = NULL;
+    d->size = 0;
+    d->total = 0;
+}
+
+static int cmp_factor(const void *a, const void *b) {
+    const KASISKI_FACTOR *x = a, *y = b;
+
+    if (x->hits != y->hits)
+        return (x->hits < y->hits) ? 1 : -1;
+    return x->length - y->length;
+}
+
+int kasiski_factors(const KASISKI_DISTANCES *d, int max_div, KASISKI_FACTOR *ranked) {
+    size_t *hits;
+
+    if (max_div < 2)
+        return 0;
+    hits = calloc(max_div + 1, sizeof(size_t));
+    if (!hits)
+        return -1;
+
+    /* Each distinct distance once, weighted by how often it occurs */
+    for (size_t i = 0; i < d->size; i++) {
+        uint32_t v = d->value[i];
+        int top = (v < (uint32_t)max_div) ? (int)v : max_div;
+        for (int k = 2; k <= top; k++) {
+            if (v % k == 0)
+                hits[k] += d->count[i];
+        }
     }
-    return a;
+
+    for (int k = 2; k <= max_div; k++) {
+        ranked[k - 2].length = k;
+        ranked[k - 2].hits = hits[k];
+    }
+    qsort(ranked, max_div - 1, sizeof(KASISKI_FACTOR), cmp_factor);
+    free(hits);
+    return max_div - 1;
 }
 
 
@@ -496,171 +963,579 @@ int shrinking_bit(LFSR *r1, LFSR *r2){
     return bit;
 }
 
-void stream_cipher(const char *input, char *output, size_t length, uint32_t seed1, uint32_t seed2) {
+/* Advances r1 to just after its nbits-th output one, i.e. past nbits shrinking bits */
+void shrinking_seek(LFSR *r1, LFSR *r2, const LFSR_TABLE *t1, uint64_t nbits) {
 
-    LFSR r1, r2;
-    lfsr_init(&r1, seed1, 0x00400006u, 32);
-    lfsr_init(&r2, seed2, 0xA3000000, 32);
+    uint64_t steps = 0;
 
-    /*Use byte because we take 8 bits at a time to XOR with each byte of input*/
-    for (size_t i = 0; i < length; i++) {
-        uint8_t key_byte = 0;
+    while (nbits > 0) {
+        LFSR before = *r1;
+        uint64_t control = lfsr_next_bits(r1, t1, 64);
+        int ones = __builtin_popcountll(control);
+
+        if ((uint64_t)ones < nbits) {
+            nbits -= ones;
+            steps += 64;
+            continue;
+        }
 
-        /* Generate 8 bits for the key byte */
-        for (int bit = 0; bit < 8; bit++) {
-            key_byte |= (shrinking_bit(&r1, &r2) << bit);
+        /* Stop right after the nbits-th control one inside this word */
+        for (uint64_t k = 1; k < nbits; k++) {
+            control &= control - 1;
         }
+        int last = __builtin_ctzll(control) + 1;
+        *r1 = before;
+        lfsr_next_bits(r1, t1, last);
+        steps += last;
+        nbits = 0;
+    }
+
+    /* The data register steps in lockstep with the control register */
+    lfsr_jump(r2, steps);
+}
+
+/* XOR with keystream bytes taken from the current generator state */
+static void stream_xor(const char *input, char *output, size_t length, SHRINKING *ctx) {
 
+    uint8_t key[STREAM_BLOCK];
+
+    /* Produce a block of keystream, then combine it with the input */
+    for (size_t i = 0; i < length; i += STREAM_BLOCK) {
+        size_t len = (length - i < STREAM_BLOCK) ? length - i : STREAM_BLOCK;
+
+        shrinking_keystream_fill(ctx, key, len);
 
         /* XOR*/
-        output[i] = input[i] ^ key_byte;
+        for (size_t j = 0; j < len; j++) {
+            output[i + j] = input[i + j] ^ key[j];
+        }
+    }
+}
+
+/* Modular addition (sign 1) or subtraction (sign -1) of 5-bit keystream symbols */
+static void stream_mod(const char *input, char *output, size_t length, SHRINKING *ctx, int mod, int sign) {
+
+    uint8_t key[STREAM_BLOCK];
+
+    for (size_t i = 0; i < length; i += STREAM_BLOCK) {
+        size_t len = (length - i < STREAM_BLOCK) ? length - i : STREAM_BLOCK;
+
+        /* Generate 5 bits for z */
+        shrinking_symbol_fill(ctx, key, len, 5);
+
+        for (size_t j = 0; j < len; j++) {
+            /*Transform letter to number 0–25*/
+            int x = input[i + j] - 'A';
+            /* Ensure key is within mod */
+            int k = key[j] % mod;
+            int y;
+
+            if (sign > 0) {
+                y = (x + k) % mod;
+            } else {
+                y = (x - k + mod) % mod;
+            }
+            output[i + j] = 'A' + y;
+        }
     }
+}
 
+void stream_cipher(const char *input, char *output, size_t length, uint32_t seed1, uint32_t seed2) {
+
+    SHRINKING ctx;
+    shrinking_init(&ctx, seed1, seed2);
+
+    stream_xor(input, output, length, &ctx);
 }
 
 
 void stream_cipher_mod(const char *input, char *output, size_t length, uint32_t seed1, uint32_t seed2, int mod) {
 
 
-    LFSR r1, r2;
-    lfsr_init(&r1, seed1, 0x00400006u, 32);
-    lfsr_init(&r2, seed2, 0xA3000000, 32);
+    SHRINKING ctx;
+    shrinking_init(&ctx, seed1, seed2);
 
-    for (size_t i = 0; i < length; i++) {
+    stream_mod(input, output, length, &ctx, mod, 1);
 
-        char c = input[i];
-        /*Transform letter to number 0–25*/
-        int x = c - 'A';  
-        int key = 0;
+    output[length] = '\0';
+}
 
-        /* Generate 5 bits for z */
-        for (int bit = 0; bit < 5; bit++) {
-            key = (key << 1) | shrinking_bit(&r1, &r2);
+void stream_decipher_mod(const char *input, char *output, size_t length, uint32_t seed1, uint32_t seed2, int mod) {
+
+    SHRINKING ctx;
+    shrinking_init(&ctx, seed1, seed2);
+
+    stream_mod(input, output, length, &ctx, mod, -1);
+
+    output[length] = '\0';
+}
+
+int default_threads(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n > 0) ? (int)n : 1;
+}
+
+/* Work shared by the stream cipher threads */
+typedef struct {
+    const char *input;
+    char *output;
+    size_t length;
+    size_t chunk;        /* bytes per chunk */
+    size_t nchunks;
+    LFSR *checkpoints;   /* (r1, r2) at the start of every chunk */
+    int mod;             /* -1 for XOR, modulus otherwise */
+    int sign;            /* 1 cipher, -1 decipher (modular only) */
+    int nthreads;
+} STREAM_JOB;
+
+typedef struct {
+    STREAM_JOB *job;
+    int id;
+} STREAM_WORKER;
+
+static void *stream_worker(void *arg) {
+    STREAM_WORKER *w = arg;
+    STREAM_JOB *job = w->job;
+
+    /* Chunks are dealt round-robin so the assignment is fixed */
+    for (size_t c = w->id; c < job->nchunks; c += job->nthreads) {
+        size_t start = c * job->chunk;
+        size_t len = job->chunk;
+        SHRINKING ctx;
+
+        shrinking_init_registers(&ctx, &job->checkpoints[2 * c], &job->checkpoints[2 * c + 1]);
+        if (start + len > job->length) {
+            len = job->length - start;
+        }
+        if (job->mod == -1) {
+            stream_xor(job->input + start, job->output + start, len, &ctx);
+        } else {
+            stream_mod(job->input + start, job->output + start, len, &ctx, job->mod, job->sign);
         }
-        /* Ensure key is within mod */
-        key %= mod;
+    }
+    return NULL;
+}
 
-        
-        int y;
-        y = (x + key) % mod;
-        output[i] = 'A' + y;
+void stream_cipher_parallel(const char *input, char *output, size_t length, uint32_t seed1, uint32_t seed2, int mod, int cipher, int nthreads) {
+
+    STREAM_JOB job;
+    SHRINKING ctx;
+    int bits_per_byte = (mod == -1) ? 8 : 5;
+
+    shrinking_init(&ctx, seed1, seed2);
+
+    if (nthreads < 1) {
+        nthreads = 1;
     }
 
-    output[length] = '\0';
+    job.input = input;
+    job.output = output;
+    job.length = length;
+    job.mod = mod;
+    job.sign = cipher ? 1 : -1;
+    job.nthreads = nthreads;
+
+    /* A few chunks per thread, but never small enough for seeking to dominate */
+    job.nchunks = (size_t)nthreads * 4;
+    job.chunk = (length + job.nchunks - 1) / job.nchunks;
+    if (job.chunk < STREAM_MIN_CHUNK) {
+        job.chunk = STREAM_MIN_CHUNK;
+    }
+    job.nchunks = (length + job.chunk - 1) / job.chunk;
+
+    pthread_t *threads = NULL;
+    STREAM_WORKER *workers = NULL;
+    int *started = NULL;
+    job.checkpoints = NULL;
+    if (nthreads > 1 && job.nchunks > 1) {
+        job.checkpoints = malloc(2 * job.nchunks * sizeof(LFSR));
+        threads = malloc(nthreads * sizeof(pthread_t));
+        workers = malloc(nthreads * sizeof(STREAM_WORKER));
+        started = calloc(nthreads, sizeof(int));
+    }
+
+    /* One thread, one chunk or no memory for the parallel state: serial */
+    if (!job.checkpoints || !threads || !workers || !started) {
+        free(job.checkpoints);
+        free(threads);
+        free(workers);
+        free(started);
+        if (mod == -1) {
+            stream_xor(input, output, length, &ctx);
+        } else {
+            stream_mod(input, output, length, &ctx, mod, job.sign);
+            output[length] = '\0';
+        }
+        return;
+    }
+
+    /* Checkpoints only need the control register's ones count, plus one jump of the data register */
+    for (size_t c = 0; c < job.nchunks; c++) {
+        if (c > 0) {
+            shrinking_seek(&ctx.r1, &ctx.r2, ctx.t1, (uint64_t)job.chunk * bits_per_byte);
+        }
+        job.checkpoints[2 * c] = ctx.r1;
+        job.checkpoints[2 * c + 1] = ctx.r2;
+    }
+
+    for (int t = 0; t < nthreads; t++) {
+        workers[t].job = &job;
+        workers[t].id = t;
+        started[t] = (pthread_create(&threads[t], NULL, stream_worker, &workers[t]) == 0);
+        if (!started[t]) {
+            /* Could not spawn, do the share in this thread */
+            stream_worker(&workers[t]);
+        }
+    }
+    for (int t = 0; t < nthreads; t++) {
+        if (started[t]) {
+            pthread_join(threads[t], NULL);
+        }
+    }
+
+    if (mod != -1) {
+        output[length] = '\0';
+    }
+
+    free(started);
+    free(workers);
+    free(threads);
+    free(job.checkpoints);
 }
 
-void stream_decipher_mod(const char *input, char *output, size_t length, uint32_t seed1, uint32_t seed2, int mod) {
 
-    LFSR r1, r2;
-    lfsr_init(&r1, seed1, 0x00400006u, 32);
-    lfsr_init(&r2, seed2, 0xA3000000, 32);
+/* IC of column i of a period from its 26 letter counts; a column with
+ * fewer than 2 letters has no pairs and counts as 0 */
+static double ic_column(const uint64_t *freq, size_t length, int n, int i){
+    size_t col_length = length / n + ((size_t)i < length % n);
+    double ic_col = 0.0;
 
+    if (col_length < 2)
+        return 0.0;
+    for (int j = 0; j < 26; j++) { /*For each letter A-Z (26 letters)*/
+        ic_col += (double)(freq[j] * (freq[j] - 1));
+    }
+    return ic_col / ((double)col_length * (col_length - 1));
+}
 
-    for (size_t i = 0; i < length; i++) {
+/* IC of a period from its column histograms (26 counters per column) */
+static double ic_from_hist(const uint64_t *hist, size_t length, int n){
+    double ic_total = 0.0;
+
+    for (int i = 0; i < n; i++) {
+        ic_total += ic_column(hist + (size_t)i * 26, length, n, i);
+    }
+    return ic_total / n;
+}
 
-        char c = input[i];
-        /*Transform letter to number 0–25*/
-        int y = c - 'A';  
-        int key = 0;
+double calculate_ic(const char *buffer, size_t length, int n) {
+    double ic_total = 0.0;
 
-        /* Generate 5 bits for z */
-        for (int bit = 0; bit < 5; bit++) {
-            key = (key << 1) | shrinking_bit(&r1, &r2);
+    /* One strided walk per column with its histogram on the stack */
+    for (int i = 0; i < n; i++) {
+        uint64_t freq[26] = {0};
+        for (size_t k = i; k < length; k += n) {
+            freq[buffer[k] - 'A']++;
         }
+        ic_total += ic_column(freq, length, n, i);
+    }
+
+    return ic_total / n;
+}
+
+void ic_workspace_init(IC_WORKSPACE *ws){
+    ws->hist = NULL;
+    ws->capacity = 0;
+}
 
+void ic_workspace_free(IC_WORKSPACE *ws){
+    free(ws->hist);
+    ws->hist = NULL;
+    ws->capacity = 0;
+}
 
-        /* Ensure key is within mod */
-        key %= mod;
+double calculate_ic_ws(IC_WORKSPACE *ws, const char *buffer, size_t length, int n) {
+    size_t span = (size_t)n * 26;
+    size_t col = 0;
 
-        
-        int x;
-        x = (y - key + mod) % mod;
-        output[i] = 'A' + x;
+    if (span > ws->capacity) {
+        uint64_t *hist = realloc(ws->hist, span * sizeof(uint64_t));
+        if (!hist) {
+            /* The strided version needs no memory */
+            return calculate_ic(buffer, length, n);
+        }
+        ws->hist = hist;
+        ws->capacity = span;
     }
 
-    output[length] = '\0';
+    /* Sequential pass, the column advances with the text instead of i % n */
+    memset(ws->hist, 0, span * sizeof(uint64_t));
+    for (size_t i = 0; i < length; i++) {
+        ws->hist[col + (buffer[i] - 'A')]++;
+        col += 26;
+        if (col == span)
+            col = 0;
+    }
+
+    return ic_from_hist(ws->hist, length, n);
 }
 
+/* Work shared by the IC profile threads */
+typedef struct {
+    const char *buffer;
+    size_t length;
+    int max_n;
+    double *ic;
+    size_t budget;       /* histogram counters per thread */
+    int nthreads;
+} IC_JOB;
+
+typedef struct {
+    IC_JOB *job;
+    int id;
+    int failed;
+} IC_WORKER;
+
+static void *ic_worker(void *arg){
+    IC_WORKER *w = arg;
+    IC_JOB *job = w->job;
+    const char *buffer = job->buffer;
+    size_t length = job->length;
+    int stride = job->nthreads;
+    int top = job->max_n - 1 - w->id;
+    uint64_t *hist = malloc(job->budget * sizeof(uint64_t));
+
+    if (!hist) {
+        w->failed = 1;
+        return NULL;
+    }
 
-void find_probable_key(const char *buffer, size_t length, int n, char *probable_key, int language) {
-    char **cols;
-    int i, j;
-    int freq[n][26];
-    int col_len[n];
-
-    const double P_english[26] = {
-        0.0804, 0.0154, 0.0306, 0.0399, 0.1251, 0.0230, 0.0196, 0.0549,
-        0.0726, 0.0016, 0.0067, 0.0414, 0.0253, 0.0709, 0.0760, 0.0200,
-        0.0011, 0.0612, 0.0654, 0.0925, 0.0271, 0.0099, 0.0192, 0.0019,
-        0.0173, 0.0019
-    };
-
-    const double P_spanish[26] = {
-        0.1196, 0.0092, 0.0292, 0.0687, 0.1678, 0.0052, 0.0073, 0.0089,
-        0.0415, 0.0030, 0.0000, 0.0837, 0.0212, 0.0701, 0.0869, 0.0277,
-        0.0153, 0.0494, 0.0788, 0.0331, 0.0480, 0.0039, 0.0000, 0.0006,
-        0.0154, 0.0015
-    };
-
-    const double *P;
-    if (language == 1){
-        P = P_spanish;
-    }else{
-        P = P_english;
-    }
-
-    cols = malloc(n * sizeof(char *));
-    for (i = 0; i < n; i++) {
-        cols[i] = malloc((((length + n - 1) / n ) + 1) * sizeof(char)); /* ceil(lentgh/n) */ 
+    /* Periods above max_n/2 are dealt round-robin: this thread counts
+     * top, top - nthreads, ... and every period folded from them */
+    while (top >= 1 && 2 * top >= job->max_n) {
+        int first = top;
+        size_t used = 0;
+
+        /* Batch of periods whose histograms fit in the budget */
+        while (top >= 1 && 2 * top >= job->max_n && used + (size_t)top * 26 <= job->budget) {
+            used += (size_t)top * 26;
+            top -= stride;
+        }
+        memset(hist, 0, used * sizeof(uint64_t));
+
+        /* One pass over the text for the whole batch, in cache-sized blocks */
+        for (size_t start = 0; start < length; start += 8192) {
+            size_t end = (length - start < 8192) ? length : start + 8192;
+            uint64_t *h = hist;
+
+            for (int n = first; n > top; n -= stride) {
+                size_t span = (size_t)n * 26;
+                size_t col = (start % n) * 26;
+                for (size_t i = start; i < end; i++) {
+                    h[col + (buffer[i] - 'A')]++;
+                    col += 26;
+                    if (col == span)
+                        col = 0;
+                }
+                h += span;
+            }
+        }
+
+        /* Each counted period gives its halves by folding column j+n onto j */
+        {
+            uint64_t *h = hist;
+            for (int n = first; n > top; n -= stride) {
+                int p = n;
+
+                job->ic[p] = ic_from_hist(h, length, p);
+                while (p % 2 == 0) {
+                    p /= 2;
+                    for (int j = 0; j < p * 26; j++)
+                        h[j] += h[j + p * 26];
+                    job->ic[p] = ic_from_hist(h, length, p);
+                }
+                h += (size_t)n * 26;
+            }
+        }
     }
 
-    /*Initialize frequency array*/
-    for (i = 0; i < n; i++) {
-        for (j = 0; j < 26; j++) {
-            freq[i][j] = 0;
+    free(hist);
+    return NULL;
+}
+
+int ic_profile(const char *buffer, size_t length, int max_n, double *ic, int nthreads){
+    IC_JOB job;
+    int counted = max_n - max_n / 2;   /* periods in [max_n/2, max_n) */
+    int failed = 0;
+
+    if (max_n < 2)
+        return 0;
+    if (counted > max_n - 1)
+        counted = max_n - 1;
+    if (nthreads < 1)
+        nthreads = 1;
+    if (nthreads > counted)
+        nthreads = counted;
+
+    job.buffer = buffer;
+    job.length = length;
+    job.max_n = max_n;
+    job.ic = ic;
+    job.nthreads = nthreads;
+    /* A single period larger than the budget still needs its own histogram */
+    job.budget = IC_PROFILE_BUDGET / nthreads;
+    if (job.budget < (size_t)(max_n - 1) * 26)
+        job.budget = (size_t)(max_n - 1) * 26;
+
+    pthread_t *threads = malloc(nthreads * sizeof(pthread_t));
+    IC_WORKER *workers = malloc(nthreads * sizeof(IC_WORKER));
+    int *started = calloc(nthreads, sizeof(int));
+
+    if (!threads || !workers || !started) {
+        free(threads);
+        free(workers);
+        free(started);
+        return -1;
+    }
+
+    for (int t = 0; t < nthreads; t++) {
+        workers[t].job = &job;
+        workers[t].id = t;
+        workers[t].failed = 0;
+        started[t] = (nthreads > 1 && pthread_create(&threads[t], NULL, ic_worker, &workers[t]) == 0);
+        if (!started[t]) {
+            /* Single thread or could not spawn, do the share in this thread */
+            ic_worker(&workers[t]);
         }
     }
+    for (int t = 0; t < nthreads; t++) {
+        if (started[t]) {
+            pthread_join(threads[t], NULL);
+        }
+        failed |= workers[t].failed;
+    }
 
-    /*Rearange text into columns and calculate frequencies*/
-    for (i = 0; i < n; i++)
-        col_len[i] = 0;
+    free(threads);
+    free(workers);
+    free(started);
+    return failed ? -1 : 0;
+}
 
-    for (i = 0; i < length; i++) {
-        int col = i % n;
-        char c = buffer[i];
-        if (c >= 'A' && c <= 'Z') {
-            cols[col][col_len[col]] = c;
-            freq[col][c - 'A']++;
-            col_len[col]++;
+int ic_best_period(const double *ic, int max_n, double target, double *best_ic){
+    double best = 0.0;
+    int best_idx = 0;
+
+    /* Strict comparison in increasing n: the first of equally close periods wins */
+    for (int i = 1; i < max_n; i++) {
+        if (fabs(ic[i] - target) < fabs(best - target)) {
+            best = ic[i];
+            best_idx = i;
         }
     }
+    if (best_ic)
+        *best_ic = best;
+    return best_idx;
+}
 
-    for (i = 0; i < n; i++) {
-        double best_M = 0.0;
-        int best_k = 0;
-        int len = col_len[i];
+int ic_default_bound(size_t length){
+    size_t bound = length / 3;
 
-        for (int k = 0; k < 26; k++) {
-            double M = 0.0;
-            for (int j = 0; j < 26; j++) {
-                int shifted = (j + k) % 26;
-                M += P[j] * ((double)freq[i][shifted] / len);
+    if (bound > IC_MAX_PERIOD)
+        bound = IC_MAX_PERIOD;
+    return (int)bound + 1;
+}
+
+const double *language_frequencies(int language) {
+    return lang_model_builtin(language)->unigram;
+}
+
+/* Two doubles at a time, lowered to whatever vector unit the target has */
+typedef double v2df __attribute__((vector_size(16)));
+
+void shift_scores(const uint64_t *freq, size_t len, const double *P, int method, double *score) {
+    double f2[52 + 2];
+    v2df acc[13] = {{0}};
+
+    /* f2[j + k] is the letter that plaintext letter j becomes under shift k */
+    for (int j = 0; j < 52; j++) {
+        f2[j] = (method == SCORE_CORRELATION) ? (double)freq[j % 26] / len : (double)freq[j % 26];
+    }
+    f2[52] = f2[53] = 0.0;
+
+    for (int j = 0; j < 26; j++) {
+        if (method == SCORE_CORRELATION) {
+            v2df p = { P[j], P[j] };
+            for (int v = 0; v < 13; v++) {
+                v2df f;
+                memcpy(&f, f2 + j + 2 * v, sizeof(f));
+                acc[v] += p * f;
             }
-            if (M > best_M) {
-                best_M = M;
-                best_k = k;
+        } else {
+            double e = len * ((P[j] < SCORE_CHI_FLOOR) ? SCORE_CHI_FLOOR : P[j]);
+            v2df ev = { e, e }, inv = { 1.0 / e, 1.0 / e };
+            for (int v = 0; v < 13; v++) {
+                v2df f, d;
+                memcpy(&f, f2 + j + 2 * v, sizeof(f));
+                d = f - ev;
+                acc[v] += d * d * inv;
+            }
+        }
+    }
+    memcpy(score, acc, 26 * sizeof(double));
+}
+
+int rank_key_shifts(const char *buffer, size_t length, int n, const double *P, int method, int top_k, SHIFT_SCORE *out) {
+    if (top_k < 1)
+        top_k = 1;
+    if (top_k > 26)
+        top_k = 26;
+
+    for (int i = 0; i < n; i++) {
+        uint64_t freq[26] = {0};
+        size_t len = 0;
+        double score[26];
+        SHIFT_SCORE *best = out + (size_t)i * top_k;
+        int kept = 0;
+
+        for (size_t k = i; k < length; k += n) {
+            char c = buffer[k];
+            if (c >= 'A' && c <= 'Z') {
+                freq[c - 'A']++;
+                len++;
             }
         }
+        shift_scores(freq, len, P, method, score);
 
-        probable_key[i] = 'A' + best_k;
+        /* Insertion into the top list; only a strictly better score moves
+         * ahead, so ties keep the smaller shift and NaN never overtakes */
+        for (int k = 0; k < 26; k++) {
+            double sc = score[k];
+            int r = kept;
+
+            while (r > 0 && ((method == SCORE_CORRELATION) ? sc > best[r - 1].score : sc < best[r - 1].score))
+                r--;
+            if (r == top_k)
+                continue;
+            if (kept < top_k)
+                kept++;
+            memmove(best + r + 1, best + r, (kept - 1 - r) * sizeof(SHIFT_SCORE));
+            best[r].shift = k;
+            best[r].score = sc;
+        }
     }
+    return top_k;
+}
 
-    probable_key[n] = '\0';
+void find_probable_key(const char *buffer, size_t length, int n, char *probable_key, int language) {
+    SHIFT_SCORE *best = malloc((n > 0 ? n : 1) * sizeof(SHIFT_SCORE));
+    int i;
 
+    rank_key_shifts(buffer, length, n, language_frequencies(language), SCORE_CORRELATION, 1, best);
     for (i = 0; i < n; i++) {
-        free(cols[i]);
+        probable_key[i] = 'A' + best[i].shift;
     }
-    free(cols);
+    probable_key[n] = '\0';
+    free(best);
 }
 
 int parse_values(const char *str, int *vec) {
@@ -8,6 +8,62 @@
 #include <gmp.h>
 #include <ctype.h>
 #include "lfsr.h"
+#include "shrinking.h"
+#include "subst.h"
+#include "suffix.h"
+#include "ngram.h"
+#include "langmodel.h"
+#include "hill.h"
+
+/* Feedback taps of the control (r1) and data (r2) registers of the stream cipher */
+#define STREAM_MASK1 0x00400006u
+#define STREAM_MASK2 0xA3000000u
+
+/* Keystream bytes produced per block before combining them with the input */
+#define STREAM_BLOCK 4096
+
+/* Smallest chunk (in bytes) handed to a stream cipher thread */
+#define STREAM_MIN_CHUNK (64 * 1024)
+
+/* Largest key length tried by the IC period search when -n is not given */
+#define IC_MAX_PERIOD 100
+
+/* Column histogram counters ic_profile keeps in memory at once */
+#define IC_PROFILE_BUDGET (1 << 21)
+
+/* Distances between consecutive occurrences of repeated n-grams, kept as
+ * distinct values with their multiplicities */
+typedef struct {
+    uint32_t *value;     /* distinct distances, increasing */
+    uint32_t *count;     /* occurrences of each distance */
+    size_t size;         /* number of distinct distances */
+    size_t total;        /* number of distances, sum of count */
+} KASISKI_DISTANCES;
+
+/* Candidate key length and how many distances it divides */
+typedef struct {
+    int length;
+    size_t hits;
+} KASISKI_FACTOR;
+
+/* Scratch histograms reused by calculate_ic_ws across calls */
+typedef struct {
+    uint64_t *hist;      /* 26 counters per column */
+    size_t capacity;     /* counters allocated */
+} IC_WORKSPACE;
+
+/* Shift scoring methods of the Vigenère key search */
+#define SCORE_CORRELATION 0   /* M = sum P[j] * f[j + k], higher is better */
+#define SCORE_CHI_SQUARED 1   /* sum (count - expected)^2 / expected, lower is better */
+
+/* Letters whose expected frequency is below this are scored with it instead */
+#define SCORE_CHI_FLOOR 0.0001
+
+/* One candidate shift of a key column and its score */
+typedef struct {
+    int shift;
+    double score;
+} SHIFT_SCORE;
 
 /*
  * ============================================================================
@@ -85,6 +141,8 @@ void inverse_mod(mpz_t a, mpz_t mod, mpz_t a_inv);
  * ============================================================================
  *  Authors     : Blanca Matas, Luis Nuñez
  *  Description : Applies the affine cipher encryption: E(x) = (a*x + b) mod m.
+ *                The 26 letter images are computed once with GMP and the
+ *                text is mapped through them with substitute_AZ.
  *  Function:
  *      void affine_cipher(const char *input, char *output, size_t length,
  *                         mpz_t a, mpz_t b, mpz_t mod);
@@ -106,6 +164,7 @@ void affine_cipher(const char *input, char *output, size_t length, mpz_t a, mpz_
  * ============================================================================
  *  Authors     : Blanca Matas, Luis Nuñez
  *  Description : Applies the affine cipher decryption: D(y) = a⁻¹ * (y - b) mod m.
+ *                Uses the same substitution table approach as affine_cipher.
  *  Function:
  *      void affine_decipher(const char *input, char *output, size_t length,
  *                           mpz_t a, mpz_t b, mpz_t mod);
@@ -126,7 +185,8 @@ void affine_decipher(const char *input, char *output, size_t length, mpz_t a, mp
 /*
  * ============================================================================
  *  Authors     : Blanca Matas, Luis Nuñez
- *  Description : Computes the determinant of a square matrix using GMP arithmetic.
+ *  Description : Computes the determinant of a square matrix using GMP arithmetic,
+ *                by fraction-free (Bareiss) elimination.
  *  Function:
  *      void determinant(mpz_t **matrix, int n, mpz_t det_out);
  *
@@ -185,15 +245,17 @@ void affine_cipher_hill(const char *input, char *output, size_t length, mpz_t **
 /*
  * ============================================================================
  *  Authors     : Blanca Matas, Luis Nuñez
- *  Description : Computes the modular inverse of a square matrix using GMP arithmetic.
- *                Currently implemented for 2x2 matrices.
+ *  Description : Computes the modular inverse of a square matrix by row
+ *                reduction mod m on native integers (mod below 2^31), or
+ *                as adj(A) / det(A) in GMP for larger moduli.
+ *                A matrix with no inverse gives the zero matrix.
  *  Function:
  *      void inverse_matrix(mpz_t **matrix, mpz_t **inv_matrix, int n, mpz_t mod);
  *
  *  Parameters:
  *      matrix     - Input matrix to invert (n x n)
  *      inv_matrix - Output matrix that will store the inverse
- *      n          - Dimension of the matrix (currently supports n = 2)
+ *      n          - Dimension of the matrix
  *      mod        - Modulus for modular arithmetic
  *  Returns:
  *      void
@@ -224,11 +286,43 @@ void inverse_matrix(mpz_t **matrix, mpz_t **inv_matrix, int n, mpz_t mod);
  */
 void affine_decipher_hill(const char *input, char *output, size_t length, mpz_t **A, mpz_t *b, int n, mpz_t mod);
 
+/* Letters read and processed at a time by affine_hill_stream */
+#define HILL_STREAM_CHUNK (1 << 20)
+
+/*
+ * ============================================================================
+ *  Authors     : Blanca Matas, Luis Nuñez
+ *  Description : Ciphers or deciphers a whole stream with the affine Hill
+ *                cipher, chunk by chunk, normalizing it to A–Z on the way.
+ *                Ciphering pads the last block with the letter 'A' + padding
+ *                and appends the padding in base 26 as a header (one letter
+ *                for n <= 26); deciphering reads the header back and drops
+ *                the padding. Memory use does not depend on the input size.
+ *  Function:
+ *      int affine_hill_stream(FILE *in, FILE *out, mpz_t **A, mpz_t *b,
+ *                             int n, mpz_t mod, int cipher);
+ *
+ *  Parameters:
+ *      in      - Input stream
+ *      out     - Output stream
+ *      A       - Key matrix (n x n)
+ *      b       - Key vector (size n)
+ *      n       - Block size (dimension)
+ *      mod     - Modulus for arithmetic operations
+ *      cipher  - 1 to cipher, 0 to decipher
+ *  Returns:
+ *      0 on success, -1 with errno set on a read, write or memory error
+ *      (EINVAL if a ciphertext has no padding header)
+ * ============================================================================
+ */
+int affine_hill_stream(FILE *in, FILE *out, mpz_t **A, mpz_t *b, int n, mpz_t mod, int cipher);
+
 /*
  * ============================================================================
  *  Authors     : Blanca Matas, Luis Nuñez
  *  Description : Encrypts text using the Vigenère cipher with a given key.
  *                Each character is shifted by the corresponding key character.
+ *                Keys of capital letters use the SIMD shift_AZ kernel.
  *  Function:
  *      void vigenere_cipher(const char *input, char *output, size_t length,
  *                           const char *key);
@@ -282,11 +376,33 @@ void vigenere_decipher(const char *input, char *output, size_t length, const cha
  */
 int normalize_AZ(char *buffer, size_t length, char *text);
 
+/*
+ * ============================================================================
+ *  Authors     : Blanca Matas, Luis Nuñez
+ *  Description : Reads a whole file (or stdin) and normalizes it to A–Z in
+ *                place, so the analysis tools share one input routine and
+ *                keep a single copy of the text.
+ *  Function:
+ *      char *read_text_AZ(const char *filename, size_t *length);
+ *
+ *  Parameters:
+ *      filename - File to read, NULL for stdin
+ *      length   - Output, number of letters in the returned text
+ *  Returns:
+ *      The NUL-terminated A–Z text (free it with free), or NULL with errno
+ *      set if the file could not be read
+ * ============================================================================
+ */
+char *read_text_AZ(const char *filename, size_t *length);
+
 /*
  * ============================================================================
  *  Authors     : Blanca Matas, Luis Nuñez
  *  Description : Calculates the Index of Coincidence (IC) for a given text.
  *                Used to estimate probable key length in Vigenère analysis.
+ *                Each column is counted by a strided walk into a 26-entry
+ *                histogram on the stack; column lengths follow from length
+ *                and n, so nothing is copied or allocated.
  *  Function:
  *      double calculate_ic(const char *buffer, size_t length, int n);
  *
@@ -300,6 +416,112 @@ int normalize_AZ(char *buffer, size_t length, char *text);
  */
 double calculate_ic(const char *buffer, size_t length, int n);
 
+/*
+ * ============================================================================
+ *  Authors     : Blanca Matas, Luis Nuñez
+ *  Description : Initializes / releases the scratch space of calculate_ic_ws.
+ *  Function:
+ *      void ic_workspace_init(IC_WORKSPACE *ws);
+ *      void ic_workspace_free(IC_WORKSPACE *ws);
+ *
+ *  Parameters:
+ *      ws - Workspace
+ *  Returns:
+ *      void
+ * ============================================================================
+ */
+void ic_workspace_init(IC_WORKSPACE *ws);
+void ic_workspace_free(IC_WORKSPACE *ws);
+
+/*
+ * ============================================================================
+ *  Authors     : Blanca Matas, Luis Nuñez
+ *  Description : Same value as calculate_ic, counted in one sequential pass
+ *                into the n x 26 histograms of a workspace. The workspace
+ *                only grows, so scanning many n allocates at most once per
+ *                new maximum. Falls back to calculate_ic if it cannot grow.
+ *  Function:
+ *      double calculate_ic_ws(IC_WORKSPACE *ws, const char *buffer,
+ *                             size_t length, int n);
+ *
+ *  Parameters:
+ *      ws     - Workspace from ic_workspace_init
+ *      buffer - Input text (A–Z uppercase)
+ *      length - Length of text
+ *      n      - Hypothesized key length
+ *  Returns:
+ *      Average Index of Coincidence value across all n columns
+ * ============================================================================
+ */
+double calculate_ic_ws(IC_WORKSPACE *ws, const char *buffer, size_t length, int n);
+
+/*
+ * ============================================================================
+ *  Authors     : Blanca Matas, Luis Nuñez
+ *  Description : Computes the Index of Coincidence of every period
+ *                1..max_n-1 at once. Only periods above max_n/2 are counted
+ *                from the text; a period n below that is obtained by folding
+ *                the column histograms of 2n (column j of n is columns j and
+ *                j+n of 2n). Periods are counted in batches so that no more
+ *                than IC_PROFILE_BUDGET counters are live, each batch in one
+ *                pass over the text. The counted periods are dealt
+ *                round-robin to nthreads threads; every ic[n] is written by
+ *                exactly one of them, so the result does not depend on
+ *                scheduling.
+ *  Function:
+ *      int ic_profile(const char *buffer, size_t length, int max_n,
+ *                     double *ic, int nthreads);
+ *
+ *  Parameters:
+ *      buffer   - Input text (A–Z uppercase)
+ *      length   - Length of text
+ *      max_n    - Exclusive bound on the key lengths
+ *      ic       - Output array of max_n entries, ic[n] receives
+ *                 calculate_ic(buffer, length, n) (ic[0] is unused)
+ *      nthreads - Number of worker threads (1 to scan in the caller)
+ *  Returns:
+ *      0 on success, -1 if memory could not be allocated
+ * ============================================================================
+ */
+int ic_profile(const char *buffer, size_t length, int max_n, double *ic, int nthreads);
+
+/*
+ * ============================================================================
+ *  Authors     : Blanca Matas, Luis Nuñez
+ *  Description : Picks the key length whose IC is closest to the expected IC
+ *                of the language. Ties go to the smallest key length.
+ *  Function:
+ *      int ic_best_period(const double *ic, int max_n, double target,
+ *                         double *best_ic);
+ *
+ *  Parameters:
+ *      ic      - IC profile filled by ic_profile
+ *      max_n   - Exclusive bound on the key lengths
+ *      target  - Expected IC of the plaintext language
+ *      best_ic - Output for the IC of the chosen length (may be NULL)
+ *  Returns:
+ *      Best key length, 0 if no length is closer than an IC of 0
+ * ============================================================================
+ */
+int ic_best_period(const double *ic, int max_n, double target, double *best_ic);
+
+/*
+ * ============================================================================
+ *  Authors     : Blanca Matas, Luis Nuñez
+ *  Description : Default exclusive bound of the IC period search: key
+ *                lengths up to IC_MAX_PERIOD, and no longer than a third of
+ *                the text so every column has a defined IC.
+ *  Function:
+ *      int ic_default_bound(size_t length);
+ *
+ *  Parameters:
+ *      length - Length of text
+ *  Returns:
+ *      Bound to use as -n
+ * ============================================================================
+ */
+int ic_default_bound(size_t length);
+
 /*
  * ============================================================================
  *  Authors     : Blanca Matas, Luis Nuñez
@@ -321,6 +543,71 @@ double calculate_ic(const char *buffer, size_t length, int n);
  */
 void find_probable_key(const char *buffer, size_t length, int n, char *probable_key, int language);
 
+/*
+ * ============================================================================
+ *  Authors     : Blanca Matas, Luis Nuñez
+ *  Description : Letter frequencies (A–Z) of the builtin language models.
+ *  Function:
+ *      const double *language_frequencies(int language);
+ *
+ *  Parameters:
+ *      language - 0 for English, 1 for Spanish
+ *  Returns:
+ *      Array of 26 probabilities
+ * ============================================================================
+ */
+const double *language_frequencies(int language);
+
+/*
+ * ============================================================================
+ *  Authors     : Blanca Matas, Luis Nuñez
+ *  Description : Scores the 26 shifts of one key column at once. The counts
+ *                are laid out twice in a row so that every circular shift is
+ *                a contiguous window, and the loop runs letters outside and
+ *                shifts inside over vectors of shifts. Each score adds its
+ *                terms in the same order as a letter-by-letter loop.
+ *  Function:
+ *      void shift_scores(const uint64_t *freq, size_t len, const double *P,
+ *                        int method, double *score);
+ *
+ *  Parameters:
+ *      freq   - Letter counts of the column (26)
+ *      len    - Letters in the column
+ *      P      - Expected letter frequencies of the language (26)
+ *      method - SCORE_CORRELATION or SCORE_CHI_SQUARED
+ *      score  - Output, score[k] for shift k (26)
+ *  Returns:
+ *      void
+ * ============================================================================
+ */
+void shift_scores(const uint64_t *freq, size_t len, const double *P, int method, double *score);
+
+/*
+ * ============================================================================
+ *  Authors     : Blanca Matas, Luis Nuñez
+ *  Description : Ranks the shifts of every column of a key of length n.
+ *                Columns are counted by strided walks, without copies.
+ *                Equal scores keep the smaller shift first, so the first
+ *                entry of each column is the letter find_probable_key picks.
+ *  Function:
+ *      int rank_key_shifts(const char *buffer, size_t length, int n,
+ *                          const double *P, int method, int top_k,
+ *                          SHIFT_SCORE *out);
+ *
+ *  Parameters:
+ *      buffer - Ciphertext text (A–Z uppercase)
+ *      length - Length of ciphertext
+ *      n      - Key length
+ *      P      - Expected letter frequencies of the language (26)
+ *      method - SCORE_CORRELATION or SCORE_CHI_SQUARED
+ *      top_k  - Shifts kept per column (1..26)
+ *      out    - Output, n * top_k entries: column i, rank r at i*top_k + r
+ *  Returns:
+ *      Number of shifts kept per column
+ * ============================================================================
+ */
+int rank_key_shifts(const char *buffer, size_t length, int n, const double *P, int method, int top_k, SHIFT_SCORE *out);
+
 /*
  * ============================================================================
  *  Authors     : Blanca Matas, Luis Nuñez
@@ -338,6 +625,50 @@ void find_probable_key(const char *buffer, size_t length, int n, char *probable_
  */
 int gcd_aux(int a, int b);
 
+/*
+ * ============================================================================
+ *  Authors     : Blanca Matas, Luis Nuñez
+ *  Description : Collects the distances between consecutive occurrences of
+ *                every n-gram that appears more than once in the text, found
+ *                with the rolling-hash n-gram index. Building it takes
+ *                O(length) memory: the index and one distance per repeat,
+ *                which are then reduced to the distinct distances.
+ *  Function:
+ *      int kasiski_distances(const char *text, size_t length, int ngram,
+ *                            KASISKI_DISTANCES *d);
+ *
+ *  Parameters:
+ *      text   - Input text (A–Z uppercase)
+ *      length - Length of text
+ *      ngram  - Length of the repeated n-grams
+ *      d      - Output, released with kasiski_distances_free
+ *  Returns:
+ *      0 on success, -1 if memory could not be allocated
+ * ============================================================================
+ */
+int kasiski_distances(const char *text, size_t length, int ngram, KASISKI_DISTANCES *d);
+void kasiski_distances_free(KASISKI_DISTANCES *d);
+
+/*
+ * ============================================================================
+ *  Authors     : Blanca Matas, Luis Nuñez
+ *  Description : Ranks the key lengths 2..max_div by the number of Kasiski
+ *                distances each of them divides, most frequent first (ties
+ *                to the shorter length).
+ *  Function:
+ *      int kasiski_factors(const KASISKI_DISTANCES *d, int max_div,
+ *                          KASISKI_FACTOR *ranked);
+ *
+ *  Parameters:
+ *      d       - Distances from kasiski_distances
+ *      max_div - Largest key length considered
+ *      ranked  - Output array of max_div - 1 entries
+ *  Returns:
+ *      Number of entries written (max_div - 1), -1 on allocation failure
+ * ============================================================================
+ */
+int kasiski_factors(const KASISKI_DISTANCES *d, int max_div, KASISKI_FACTOR *ranked);
+
 /*
  * ============================================================================
  *  Authors     : Blanca Matas, Luis Nuñez
@@ -421,6 +752,69 @@ void stream_cipher_mod(const char *input, char *output, size_t length, uint32_t
  */
 void stream_decipher_mod(const char *input, char *output, size_t length, uint32_t seed1, uint32_t seed2, int mod);
 
+/*
+ * ============================================================================
+ *  Authors     : Blanca Matas, Luis Nuñez
+ *  Description : Advances a shrinking generator past nbits output bits without
+ *                producing them. Only the control register is stepped (64 bits
+ *                at a time, counting its ones); the data register is moved
+ *                with a single lfsr_jump.
+ *  Function:
+ *      void shrinking_seek(LFSR *r1, LFSR *r2, const LFSR_TABLE *t1,
+ *                          uint64_t nbits);
+ *
+ *  Parameters:
+ *      r1    - Control LFSR
+ *      r2    - Data LFSR
+ *      t1    - Transition tables built for r1's mask and size
+ *      nbits - Number of shrinking generator bits to skip
+ *  Returns:
+ *      void
+ * ============================================================================
+ */
+void shrinking_seek(LFSR *r1, LFSR *r2, const LFSR_TABLE *t1, uint64_t nbits);
+
+/*
+ * ============================================================================
+ *  Authors     : Blanca Matas, Luis Nuñez
+ *  Description : Returns the number of online CPU cores (at least 1).
+ *  Function:
+ *      int default_threads(void);
+ *
+ *  Returns:
+ *      Number of threads to use by default
+ * ============================================================================
+ */
+int default_threads(void);
+
+/*
+ * ============================================================================
+ *  Authors     : Blanca Matas, Luis Nuñez
+ *  Description : Multi-threaded version of the stream ciphers. The keystream is
+ *                checkpointed every chunk with shrinking_seek and each thread
+ *                encrypts whole chunks from its checkpoint. Output is identical
+ *                to stream_cipher / stream_cipher_mod / stream_decipher_mod.
+ *  Function:
+ *      void stream_cipher_parallel(const char *input, char *output,
+ *                                  size_t length, uint32_t seed1,
+ *                                  uint32_t seed2, int mod, int cipher,
+ *                                  int nthreads);
+ *
+ *  Parameters:
+ *      input    - Input data
+ *      output   - Output buffer (length + 1 bytes in modular mode)
+ *      length   - Length of data
+ *      seed1    - Seed for first LFSR
+ *      seed2    - Seed for second LFSR
+ *      mod      - -1 for the XOR cipher, modulus for the modular cipher
+ *      cipher   - 1 to cipher, 0 to decipher (modular only)
+ *      nthreads - Number of worker threads
+ *  Returns:
+ *      void
+ * ============================================================================
+ */
+void stream_cipher_parallel(const char *input, char *output, size_t length, uint32_t seed1, uint32_t seed2, int mod, int cipher, int nthreads);
+
 /*
  * ============================================================================
  *  Authors     : Blanca Matas, Luis Nuñez
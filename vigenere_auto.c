@@ -0,0 +1,326 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <math.h>
+#include <bits/getopt_core.h>
+#include "utils.h"
+
+#define KASISKI_NGRAM 3
+#define MAX_CANDIDATES 20
+
+/* Work of the IC thread */
+typedef struct {
+    const char *text;
+    size_t length;
+    int max_n;
+    int nthreads;
+    double *profile;
+    int status;
+} IC_TASK;
+
+/* Work of the Kasiski thread */
+typedef struct {
+    const char *text;
+    size_t length;
+    int max_n;
+    KASISKI_FACTOR *ranked;
+    int nranked;
+} KASISKI_TASK;
+
+/* A deciphered candidate */
+typedef struct {
+    char *key;
+    int length;
+    double score;
+} CANDIDATE;
+
+static void *ic_task(void *arg) {
+    IC_TASK *t = arg;
+
+    t->status = ic_profile(t->text, t->length, t->max_n, t->profile, t->nthreads);
+    return NULL;
+}
+
+static void *kasiski_task(void *arg) {
+    KASISKI_TASK *t = arg;
+    KASISKI_DISTANCES d;
+
+    t->nranked = -1;
+    if (kasiski_distances(t->text, t->length, KASISKI_NGRAM, &d) != 0)
+        return NULL;
+    t->nranked = kasiski_factors(&d, t->max_n, t->ranked);
+    kasiski_distances_free(&d);
+    return NULL;
+}
+
+/* Adds a period to the candidate list unless it is already there */
+static int add_period(int *periods, int count, int p) {
+    for (int i = 0; i < count; i++) {
+        if (periods[i] == p)
+            return count;
+    }
+    periods[count] = p;
+    return count + 1;
+}
+
+/* Shortest period of a key: CRYPTOCRYPTO is CRYPTO */
+static int key_period(const char *key, int length) {
+    for (int p = 1; p < length; p++) {
+        if (length % p != 0)
+            continue;
+        int i = p;
+        while (i < length && key[i] == key[i - p])
+            i++;
+        if (i == length)
+            return p;
+    }
+    return length;
+}
+
+/* Best score first, ties to the shorter key */
+static int cmp_candidate(const void *a, const void *b) {
+    const CANDIDATE *x = a, *y = b;
+
+    if (x->score != y->score)
+        return (x->score < y->score) ? 1 : -1;
+    return x->length - y->length;
+}
+
+int main(int argc, char *argv[]) {
+    int opt;
+    int n = -1; /* Largest key length tried */
+    int ncand = 5; /* Periods taken from each detector */
+    char *input_filename = NULL;
+    char *output_filename = NULL;
+    FILE *output_file = NULL;
+    int language = 0; /* 0 for English, 1 for Spanish (DEFAULT: ENGLISH)*/
+    int nthreads = default_threads();
+    char *model_filename = NULL; /* Overrides -l */
+    LANG_MODEL loaded;
+    const LANG_MODEL *model;
+    int print_plaintext = 0;
+
+    int i;
+
+    /* Parse command line arguments */
+    while ((opt = getopt(argc, argv, "n:c:i:o:l:L:t:d")) != -1) {
+        switch (opt) {
+            case 'n':
+                n = atoi(optarg);
+                break;
+            case 'c':
+                ncand = atoi(optarg);
+                break;
+            case 'i':
+                input_filename = optarg;
+                break;
+            case 'o':
+                output_filename = optarg;
+                break;
+            case 'l':
+                language = atoi(optarg);
+                break;
+            case 'L':
+                model_filename = optarg;
+                break;
+            case 't':
+                nthreads = atoi(optarg);
+                break;
+            case 'd':
+                print_plaintext = 1;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-n max key length] [-c candidates per detector] [-l language (0 for english / 1 for spanish)] [-L modelfile] [-t threads] [-d] [-i infile] [-o outfile]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (ncand < 1 || ncand > MAX_CANDIDATES) {
+        fprintf(stderr, "Error: -c must be in 1..%d.\n", MAX_CANDIDATES);
+        return EXIT_FAILURE;
+    }
+
+    /*Language model: builtin unless a model file is given*/
+    model = lang_model_builtin(language);
+    if (model_filename != NULL) {
+        if (lang_model_load(&loaded, model_filename) != 0) {
+            perror("Error loading model file");
+            return EXIT_FAILURE;
+        }
+        model = &loaded;
+    }
+
+    /*Read and normalize the input once; every stage reads this buffer*/
+    size_t length = 0;
+    char *text = read_text_AZ(input_filename, &length);
+    if (text == NULL) {
+        perror("Error reading input");
+        return EXIT_FAILURE;
+    }
+
+    if (n <= 0) {
+        n = ic_default_bound(length);
+    }
+    if (n < 2 || length < 2) {
+        fprintf(stderr, "Error: text too short.\n");
+        free(text);
+        return EXIT_FAILURE;
+    }
+
+    double *profile = malloc(n * sizeof(double));
+    KASISKI_FACTOR *factors = malloc(n * sizeof(KASISKI_FACTOR));
+    char *plain = malloc(length + 1);
+    char *key = malloc(n + 1);
+    CANDIDATE *cands = calloc(2 * ncand, sizeof(CANDIDATE));
+    int *used = calloc(n, sizeof(int));
+    SHIFT_SCORE *ranked = malloc(n * sizeof(SHIFT_SCORE));
+    if (!profile || !factors || !plain || !key || !cands || !used || !ranked) {
+        perror("malloc");
+        free(used);
+        free(ranked);
+        free(profile);
+        free(factors);
+        free(plain);
+        free(key);
+        free(cands);
+        free(text);
+        return EXIT_FAILURE;
+    }
+
+    /*Both period detectors at once: Kasiski on its own thread, IC on the rest*/
+    IC_TASK ic = { text, length, n, nthreads > 1 ? nthreads - 1 : 1, profile, -1 };
+    KASISKI_TASK ka = { text, length, n - 1, factors, -1 };
+    pthread_t kasiski_thread;
+    int started = (nthreads > 1 && pthread_create(&kasiski_thread, NULL, kasiski_task, &ka) == 0);
+
+    ic_task(&ic);
+    if (started) {
+        pthread_join(kasiski_thread, NULL);
+    } else {
+        kasiski_task(&ka);
+    }
+    if (ic.status != 0 || ka.nranked < 0) {
+        perror("malloc");
+        free(used);
+        free(ranked);
+        free(profile);
+        free(factors);
+        free(plain);
+        free(key);
+        free(cands);
+        free(text);
+        return EXIT_FAILURE;
+    }
+
+    /*Candidate periods: the IC closest to the language, then the Kasiski best*/
+    int periods[2 * MAX_CANDIDATES];
+    int nperiods = 0;
+    for (int c = 0; c < ncand && c < n - 1; c++) {
+        int best = 0;
+        for (i = 1; i < n; i++) {
+            if (!used[i] && (best == 0 || fabs(profile[i] - model->ic) < fabs(profile[best] - model->ic))) {
+                best = i;
+            }
+        }
+        used[best] = 1;
+        nperiods = add_period(periods, nperiods, best);
+    }
+    for (int c = 0; c < ncand && c < ka.nranked && factors[c].hits > 0; c++) {
+        nperiods = add_period(periods, nperiods, factors[c].length);
+    }
+
+    /*Key of every period, checked by deciphering and scoring the plaintext*/
+    int ncands = 0;
+    for (int c = 0; c < nperiods; c++) {
+        int p = periods[c];
+        int dup = 0;
+
+        rank_key_shifts(text, length, p, model->unigram, SCORE_CORRELATION, 1, ranked);
+        for (i = 0; i < p; i++) {
+            key[i] = 'A' + ranked[i].shift;
+        }
+        p = key_period(key, p);
+        key[p] = '\0';
+        for (i = 0; i < ncands; i++) {
+            if (strcmp(cands[i].key, key) == 0)
+                dup = 1;
+        }
+        if (dup)
+            continue;
+
+        vigenere_decipher(text, plain, length, key);
+        cands[ncands].key = strdup(key);
+        cands[ncands].length = p;
+        cands[ncands].score = lang_fitness(model, plain, length);
+        if (cands[ncands].key == NULL) {
+            perror("malloc");
+            break;
+        }
+        ncands++;
+    }
+    qsort(cands, ncands, sizeof(CANDIDATE), cmp_candidate);
+
+    /*Open the output file for writing*/
+    if (output_filename == NULL) {
+        output_file = stdout;
+    } else {
+        output_file = fopen(output_filename, "w");
+        if (output_file == NULL) {
+            perror("Error opening output file");
+            for (i = 0; i < ncands; i++) {
+                free(cands[i].key);
+            }
+            free(used);
+            free(ranked);
+            free(profile);
+            free(factors);
+            free(plain);
+            free(key);
+            free(cands);
+            free(text);
+            return EXIT_FAILURE;
+        }
+    }
+
+    fprintf(output_file, "====== VIGENERE BREAKER =====\n");
+    fprintf(output_file, "Letters: %zu\n", length);
+    fprintf(output_file, "Candidate key lengths:");
+    for (i = 0; i < nperiods; i++) {
+        fprintf(output_file, " %d", periods[i]);
+    }
+    fprintf(output_file, "\n");
+    fprintf(output_file, "Scoring: %s %s log-likelihood, higher is better\n",
+            model->name, model->quadgram_log ? "quadgram" : "unigram");
+    fprintf(output_file, "\n");
+    for (i = 0; i < ncands; i++) {
+        fprintf(output_file, "%2d. %s (length %d): %.2f (%.4f per letter)\n", i + 1,
+                cands[i].key, cands[i].length, cands[i].score, cands[i].score / length);
+    }
+
+    if (print_plaintext && ncands > 0) {
+        vigenere_decipher(text, plain, length, cands[0].key);
+        plain[length] = '\0';
+        fprintf(output_file, "\nPlaintext (key %s):\n%s\n", cands[0].key, plain);
+    }
+
+    /* Clean up */
+    fclose(output_file);
+    for (i = 0; i < ncands; i++) {
+        free(cands[i].key);
+    }
+    free(used);
+    free(ranked);
+    free(profile);
+    free(factors);
+    free(plain);
+    free(key);
+    free(cands);
+    free(text);
+    if (model_filename != NULL) {
+        lang_model_close(&loaded);
+    }
+
+    return EXIT_SUCCESS;
+}